@@ -17,6 +17,21 @@ enum arm_pmu_type {
 	ARM_NUM_PMU_DEVICES,
 };
 
+struct platform_device;
+
+/*
+ * struct arm_pmu_platdata - ARM PMU platform data
+ *
+ * @reserve: called when the counters are taken into use, e.g. to power
+ *	up the logic the PMU interrupt is routed through.  A non-zero
+ *	return fails the reservation.
+ * @release: undoes @reserve once the counters are no longer in use.
+ */
+struct arm_pmu_platdata {
+	int (*reserve)(struct platform_device *pdev);
+	void (*release)(struct platform_device *pdev);
+};
+
 #ifdef CONFIG_CPU_HAS_PMU
 
 /**
@@ -379,6 +379,7 @@ validate_group(struct perf_event *event)
 static int
 armpmu_reserve_hardware(void)
 {
+	struct arm_pmu_platdata *plat;
 	int i, err = -ENODEV, irq;
 
 	pmu_device = reserve_pmu(ARM_PMU_DEVICE_CPU);
@@ -394,6 +395,17 @@ armpmu_reserve_hardware(void)
 		return -ENODEV;
 	}
 
+	plat = dev_get_platdata(&pmu_device->dev);
+	if (plat && plat->reserve) {
+		err = plat->reserve(pmu_device);
+		if (err) {
+			pr_warning("unable to power up pmu\n");
+			release_pmu(pmu_device);
+			pmu_device = NULL;
+			return err;
+		}
+	}
+
 	for (i = 0; i < pmu_device->num_resources; ++i) {
 		irq = platform_get_irq(pmu_device, i);
 		if (irq < 0)
@@ -415,6 +427,8 @@ armpmu_reserve_hardware(void)
 			if (irq >= 0)
 				free_irq(irq, NULL);
 		}
+		if (plat && plat->release)
+			plat->release(pmu_device);
 		release_pmu(pmu_device);
 		pmu_device = NULL;
 	}
@@ -425,6 +439,7 @@ armpmu_reserve_hardware(void)
 static void
 armpmu_release_hardware(void)
 {
+	struct arm_pmu_platdata *plat = dev_get_platdata(&pmu_device->dev);
 	int i, irq;
 
 	for (i = pmu_device->num_resources - 1; i >= 0; --i) {
@@ -434,6 +449,8 @@ armpmu_release_hardware(void)
 	}
 	armpmu->stop();
 
+	if (plat && plat->release)
+		plat->release(pmu_device);
 	release_pmu(pmu_device);
 	pmu_device = NULL;
 }
@@ -1420,8 +1437,8 @@ enum armv7_a9_perf_types {
 static const unsigned armv7_a8_perf_map[PERF_COUNT_HW_MAX] = {
 	[PERF_COUNT_HW_CPU_CYCLES]	    = ARMV7_PERFCTR_CPU_CYCLES,
 	[PERF_COUNT_HW_INSTRUCTIONS]	    = ARMV7_PERFCTR_INSTR_EXECUTED,
-	[PERF_COUNT_HW_CACHE_REFERENCES]    = HW_OP_UNSUPPORTED,
-	[PERF_COUNT_HW_CACHE_MISSES]	    = HW_OP_UNSUPPORTED,
+	[PERF_COUNT_HW_CACHE_REFERENCES]    = ARMV7_PERFCTR_DCACHE_ACCESS,
+	[PERF_COUNT_HW_CACHE_MISSES]	    = ARMV7_PERFCTR_DCACHE_REFILL,
 	[PERF_COUNT_HW_BRANCH_INSTRUCTIONS] = ARMV7_PERFCTR_PC_WRITE,
 	[PERF_COUNT_HW_BRANCH_MISSES]	    = ARMV7_PERFCTR_PC_BRANCH_MIS_PRED,
 	[PERF_COUNT_HW_BUS_CYCLES]	    = ARMV7_PERFCTR_CLOCK_CYCLES,
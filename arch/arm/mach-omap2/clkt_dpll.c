@@ -16,6 +16,7 @@
 
 #include <linux/kernel.h>
 #include <linux/errno.h>
+#include <linux/string.h>
 #include <linux/clk.h>
 #include <linux/io.h>
 
@@ -280,9 +281,47 @@ int omap2_dpll_set_rate_tolerance(struct clk *clk, unsigned int tolerance)
 
 	clk->dpll_data->rate_tolerance = tolerance;
 
+	/* Cached M/N values were picked with the old tolerance */
+	memset(clk->dpll_data->rounded, 0, sizeof(clk->dpll_data->rounded));
+
 	return 0;
 }
 
+/* Look up a previous rounding of @target_rate; loads last_rounded_* */
+static bool _dpll_rounded_lookup(struct dpll_data *dd,
+				 unsigned long target_rate)
+{
+	struct dpll_rounded *dr;
+	int i;
+
+	for (i = 0; i < DPLL_ROUNDED_CACHE; i++) {
+		dr = &dd->rounded[i];
+		if (dr->target_rate == target_rate &&
+		    dr->ref_rate == dd->clk_ref->rate) {
+			dd->last_rounded_m = dr->m;
+			dd->last_rounded_n = dr->n;
+			dd->last_rounded_rate = dr->rate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void _dpll_rounded_store(struct dpll_data *dd,
+				unsigned long target_rate)
+{
+	struct dpll_rounded *dr = &dd->rounded[dd->rounded_next];
+
+	dr->target_rate = target_rate;
+	dr->ref_rate = dd->clk_ref->rate;
+	dr->rate = dd->last_rounded_rate;
+	dr->m = dd->last_rounded_m;
+	dr->n = dd->last_rounded_n;
+
+	dd->rounded_next = (dd->rounded_next + 1) % DPLL_ROUNDED_CACHE;
+}
+
 /**
  * omap2_dpll_round_rate - round a target rate for an OMAP DPLL
  * @clk: struct clk * for a DPLL
@@ -311,6 +350,9 @@ long omap2_dpll_round_rate(struct clk *clk, unsigned long target_rate)
 
 	dd = clk->dpll_data;
 
+	if (_dpll_rounded_lookup(dd, target_rate))
+		return dd->last_rounded_rate;
+
 	pr_debug("clock: starting DPLL round_rate for clock %s, target rate "
 		 "%ld\n", clk->name, target_rate);
 
@@ -380,6 +422,8 @@ long omap2_dpll_round_rate(struct clk *clk, unsigned long target_rate)
 	pr_debug("clock: final rate: %ld  (target rate: %ld)\n",
 		 dd->last_rounded_rate, target_rate);
 
+	_dpll_rounded_store(dd, target_rate);
+
 	return dd->last_rounded_rate;
 }
 
@@ -24,6 +24,10 @@
 
 #include <linux/sched.h>
 #include <linux/cpuidle.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/pm_qos_params.h>
+#include <linux/tick.h>
 
 #include <plat/prcm.h>
 #include <plat/irqs.h>
@@ -47,15 +51,61 @@
 
 #define OMAP3_STATE_MAX OMAP3_STATE_C7
 
+#define OMAP3_LAT_BUCKETS	32
+#define OMAP3_LAT_UPDATE	32	/* re-derive exit latency every N */
+#define OMAP3_LAT_DECAY		1024	/* halve the histogram past this */
+
+/*
+ * Exit latencies are read off sched_clock().  Only the sys_clk GPTIMER
+ * backing resolves the microseconds that C1..C3 cost; on the 32KHz sync
+ * counter every sample would be off by up to a ~30us tick.
+ */
+#ifdef CONFIG_OMAP_GPTIMER_CLOCKSOURCE
+#define OMAP3_LAT_MEASURE	1
+#else
+#define OMAP3_LAT_MEASURE	0
+#endif
+
+/*
+ * Part of the overshoot is timekeeping rather than the state's exit
+ * cost.  A 32KHz clockevent fires up to one tick after the programmed
+ * time.  When PER or CORE leave ON, the GPTIMER clocksource restarts on
+ * a 32k edge (omap2_gp_clocksource_resume_idle()), which can take up to
+ * another tick.  The worst case of both is taken off every sample, so a
+ * measured figure never overstates the state; the configured latency
+ * stays the floor anyway.
+ */
+#define OMAP3_32K_TICK_NS	30518
+#ifdef CONFIG_OMAP_32K_TIMER
+#define OMAP3_LAT_CLKEVT_SLACK	OMAP3_32K_TICK_NS
+#else
+#define OMAP3_LAT_CLKEVT_SLACK	0
+#endif
+
+/*
+ * Measured exit latencies, binned on a half-octave scale in usecs:
+ * bucket 2n covers [2^n, 1.5 * 2^n), bucket 2n+1 [1.5 * 2^n, 2^(n+1)).
+ */
+struct omap3_cx_stats {
+	u32 hist[OMAP3_LAT_BUCKETS];
+	u32 samples;		/* currently in hist[] */
+	u32 max;
+	u32 measured;		/* 99th percentile of hist[] */
+	u64 total_samples;
+	u64 total_us;
+};
+
 struct omap3_processor_cx {
 	u8 valid;
 	u8 type;
 	u32 sleep_latency;
 	u32 wakeup_latency;
+	u32 static_latency;	/* sleep + wakeup, as configured */
 	u32 mpu_state;
 	u32 core_state;
 	u32 threshold;
 	u32 flags;
+	struct omap3_cx_stats stats;
 };
 
 struct omap3_processor_cx omap3_power_states[OMAP3_MAX_STATES];
@@ -108,6 +158,70 @@ static int _cpuidle_deny_idle(struct powerdomain *pwrdm,
 	return 0;
 }
 
+static int omap3_lat_bucket(u32 us)
+{
+	int l;
+
+	if (us < 2)
+		return us;
+
+	l = fls(us) - 1;
+	if (l >= OMAP3_LAT_BUCKETS / 2)
+		return OMAP3_LAT_BUCKETS - 1;
+
+	return 2 * l + ((us >> (l - 1)) & 1);
+}
+
+/* largest latency, in usecs, that falls into bucket @b */
+static u32 omap3_lat_bucket_max(int b)
+{
+	if (b < 2)
+		return b;
+
+	return ((3 + (b & 1)) << (b / 2 - 1)) - 1;
+}
+
+/*
+ * Account one measured exit latency for @state, and every
+ * OMAP3_LAT_UPDATE samples let the governor see the 99th percentile
+ * if that's worse than the configured figure.
+ */
+static void omap3_cx_record_latency(struct cpuidle_state *state,
+				    struct omap3_processor_cx *cx, u32 us)
+{
+	struct omap3_cx_stats *st = &cx->stats;
+	u32 left;
+	int b;
+
+	st->hist[omap3_lat_bucket(us)]++;
+	st->samples++;
+	st->total_samples++;
+	st->total_us += us;
+	if (us > st->max)
+		st->max = us;
+
+	if (st->samples % OMAP3_LAT_UPDATE)
+		return;
+
+	left = st->samples / 100;
+	for (b = OMAP3_LAT_BUCKETS - 1; b > 0; b--) {
+		if (st->hist[b] > left)
+			break;
+		left -= st->hist[b];
+	}
+	st->measured = omap3_lat_bucket_max(b);
+	state->exit_latency = max(cx->static_latency, st->measured);
+
+	/* Age the history so it follows OPP and board changes */
+	if (st->samples >= OMAP3_LAT_DECAY) {
+		st->samples = 0;
+		for (b = 0; b < OMAP3_LAT_BUCKETS; b++) {
+			st->hist[b] >>= 1;
+			st->samples += st->hist[b];
+		}
+	}
+}
+
 /**
  * omap3_enter_idle - Programs OMAP3 to enter the specified state
  * @dev: cpuidle device
@@ -115,18 +229,25 @@ static int _cpuidle_deny_idle(struct powerdomain *pwrdm,
  *
  * Called from the CPUidle framework to program the device to the
  * specified target state selected by the governor.
+ *
+ * When we wake up after the next timer event was due, the overshoot,
+ * less the timer slack above, is the real entry + exit cost of the state
+ * for this board and OPP, so it's fed into the state's latency histogram.
  */
 static int omap3_enter_idle(struct cpuidle_device *dev,
 			struct cpuidle_state *state)
 {
 	struct omap3_processor_cx *cx = cpuidle_get_statedata(state);
-	struct timespec ts_preidle, ts_postidle, ts_idle;
+	unsigned long long preidle, postidle, expected;
 	u32 mpu_state = cx->mpu_state, core_state = cx->core_state;
+	bool slept = false;
+	s64 late, slack = OMAP3_LAT_CLKEVT_SLACK;
 
 	current_cx_state = *cx;
 
 	/* Used to keep track of the total time in idle */
-	getnstimeofday(&ts_preidle);
+	preidle = sched_clock();
+	expected = preidle + ktime_to_ns(tick_nohz_get_sleep_length());
 
 	local_irq_disable();
 	local_fiq_disable();
@@ -134,6 +255,11 @@ static int omap3_enter_idle(struct cpuidle_device *dev,
 	pwrdm_set_next_pwrst(mpu_pd, mpu_state);
 	pwrdm_set_next_pwrst(core_pd, core_state);
 
+	/* same test omap_sram_idle() uses to stop the GPTIMER */
+	if (core_state < PWRDM_POWER_ON ||
+	    pwrdm_read_next_pwrst(per_pd) < PWRDM_POWER_ON)
+		slack += OMAP3_32K_TICK_NS;
+
 	if (omap_irq_pending() || need_resched())
 		goto return_sleep_time;
 
@@ -144,6 +270,7 @@ static int omap3_enter_idle(struct cpuidle_device *dev,
 
 	/* Execute ARM wfi */
 	omap_sram_idle();
+	slept = true;
 
 	if (cx->type == OMAP3_STATE_C1) {
 		pwrdm_for_each_clkdm(mpu_pd, _cpuidle_allow_idle);
@@ -151,13 +278,32 @@ static int omap3_enter_idle(struct cpuidle_device *dev,
 	}
 
 return_sleep_time:
-	getnstimeofday(&ts_postidle);
-	ts_idle = timespec_sub(ts_postidle, ts_preidle);
+	postidle = sched_clock();
+	if (OMAP3_LAT_MEASURE && slept) {
+		late = (s64)(postidle - expected);
+		if (late >= 0 && late < NSEC_PER_SEC)
+			omap3_cx_record_latency(state, cx,
+					div_u64(max_t(s64, late - slack, 0),
+						NSEC_PER_USEC));
+	}
 
 	local_irq_enable();
 	local_fiq_enable();
 
-	return ts_idle.tv_nsec / NSEC_PER_USEC + ts_idle.tv_sec * USEC_PER_SEC;
+	return div_u64(postidle - preidle, NSEC_PER_USEC);
+}
+
+/*
+ * A state is usable if it's enabled and its current (possibly measured)
+ * exit latency fits the tightest PM QoS wakeup constraint.  The governor
+ * checked that too, but against the latency it saw at selection time.
+ */
+static inline int omap3_state_allowed(struct cpuidle_state *state,
+				      int latency_req)
+{
+	struct omap3_processor_cx *cx = cpuidle_get_statedata(state);
+
+	return cx->valid && state->exit_latency <= latency_req;
 }
 
 /**
@@ -173,15 +319,13 @@ static struct cpuidle_state *next_valid_state(struct cpuidle_device *dev,
 						struct cpuidle_state *curr)
 {
 	struct cpuidle_state *next = NULL;
-	struct omap3_processor_cx *cx;
-
-	cx = (struct omap3_processor_cx *)cpuidle_get_statedata(curr);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
 
 	/* Check if current state is valid */
-	if (cx->valid) {
+	if (omap3_state_allowed(curr, latency_req)) {
 		return curr;
 	} else {
-		u8 idx = OMAP3_STATE_MAX;
+		int idx = OMAP3_STATE_MAX;
 
 		/*
 		 * Reach the current state starting at highest C-state
@@ -204,18 +348,18 @@ static struct cpuidle_state *next_valid_state(struct cpuidle_device *dev,
 		 */
 		idx--;
 		for (; idx >= OMAP3_STATE_C1; idx--) {
-			struct omap3_processor_cx *cx;
-
-			cx = cpuidle_get_statedata(&dev->states[idx]);
-			if (cx->valid) {
+			if (omap3_state_allowed(&dev->states[idx],
+						latency_req)) {
 				next = &dev->states[idx];
 				break;
 			}
 		}
 		/*
-		 * C1 and C2 are always valid.
-		 * So, no need to check for 'next==NULL' outside this loop.
+		 * C1 and C2 are always valid, but a tight enough QoS
+		 * constraint may still rule them out: C1 it is then.
 		 */
+		if (idx < OMAP3_STATE_C1)
+			next = dev->safe_state;
 	}
 
 	return next;
@@ -292,6 +436,94 @@ select_state:
 
 DEFINE_PER_CPU(struct cpuidle_device, omap3_idle_dev);
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * <debugfs>/cpuidle_latency: configured vs. measured exit latency of
+ * each C-state, plus the histogram behind it.  Measurements already
+ * have the timer slack taken off.  Writing anything resets them and the
+ * governor goes back to the configured values.
+ */
+static int omap3_idle_latency_show(struct seq_file *s, void *unused)
+{
+	struct cpuidle_device *dev = &per_cpu(omap3_idle_dev, 0);
+	int i, b;
+
+	seq_printf(s, "state  static  exit    p99     max     avg     "
+		   "samples\n");
+
+	for (i = 0; i < dev->state_count; i++) {
+		struct cpuidle_state *state = &dev->states[i];
+		struct omap3_processor_cx *cx = cpuidle_get_statedata(state);
+		struct omap3_cx_stats *st = &cx->stats;
+		u64 avg = st->total_us;
+
+		if (st->total_samples)
+			do_div(avg, st->total_samples);
+
+		seq_printf(s, "%-6s %-7u %-7u %-7u %-7u %-7llu %llu\n",
+			   state->name, cx->static_latency,
+			   state->exit_latency, st->measured, st->max,
+			   avg, st->total_samples);
+	}
+
+	for (i = 0; i < dev->state_count; i++) {
+		struct cpuidle_state *state = &dev->states[i];
+		struct omap3_processor_cx *cx = cpuidle_get_statedata(state);
+
+		seq_printf(s, "%s:", state->name);
+		for (b = 0; b < OMAP3_LAT_BUCKETS; b++)
+			if (cx->stats.hist[b])
+				seq_printf(s, " <=%u:%u",
+					   omap3_lat_bucket_max(b),
+					   cx->stats.hist[b]);
+		seq_printf(s, "\n");
+	}
+
+	return 0;
+}
+
+static int omap3_idle_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap3_idle_latency_show, NULL);
+}
+
+static ssize_t omap3_idle_latency_write(struct file *file,
+					const char __user *buf,
+					size_t n, loff_t *ppos)
+{
+	struct cpuidle_device *dev = &per_cpu(omap3_idle_dev, 0);
+	int i;
+
+	cpuidle_pause_and_lock();
+	for (i = 0; i < dev->state_count; i++) {
+		struct cpuidle_state *state = &dev->states[i];
+		struct omap3_processor_cx *cx = cpuidle_get_statedata(state);
+
+		memset(&cx->stats, 0, sizeof(cx->stats));
+		state->exit_latency = cx->static_latency;
+	}
+	cpuidle_resume_and_unlock();
+
+	return n;
+}
+
+static const struct file_operations omap3_idle_latency_fops = {
+	.open		= omap3_idle_latency_open,
+	.read		= seq_read,
+	.write		= omap3_idle_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init omap3_idle_latency_debugfs_init(void)
+{
+	(void) debugfs_create_file("cpuidle_latency", S_IRUGO | S_IWUSR,
+				   NULL, NULL, &omap3_idle_latency_fops);
+}
+#else
+static inline void omap3_idle_latency_debugfs_init(void) {}
+#endif
+
 /**
  * omap3_cpuidle_update_states() - Update the cpuidle states
  * @mpu_deepest_state:	Enable states upto and including this for mpu domain
@@ -502,7 +734,8 @@ int __init omap3_idle_init(void)
 		if (!cx->valid)
 			continue;
 		cpuidle_set_statedata(state, cx);
-		state->exit_latency = cx->sleep_latency + cx->wakeup_latency;
+		cx->static_latency = cx->sleep_latency + cx->wakeup_latency;
+		state->exit_latency = cx->static_latency;
 		state->target_residency = cx->threshold;
 		state->flags = cx->flags;
 		state->enter = (state->flags & CPUIDLE_FLAG_CHECK_BM) ?
@@ -528,6 +761,8 @@ int __init omap3_idle_init(void)
 		return -EIO;
 	}
 
+	omap3_idle_latency_debugfs_init();
+
 	return 0;
 }
 #else
@@ -552,6 +552,49 @@ static struct resource omap3_pmu_resource = {
 	.flags	= IORESOURCE_IRQ,
 };
 
+/*
+ * On OMAP3 the PMU overflow interrupt reaches the INTC through the EMU
+ * domain, which is kept asleep when no debug clock is in use.  Hold one
+ * of its clocks for as long as perf has the counters, or sampling
+ * silently gets no interrupts.
+ */
+static struct clk *omap3_pmu_emu_clk;
+
+static int omap3_pmu_reserve(struct platform_device *pdev)
+{
+	int ret;
+
+	omap3_pmu_emu_clk = clk_get(NULL, "pclk_fck");
+	if (IS_ERR(omap3_pmu_emu_clk)) {
+		/* no EMU clock tree on this SoC variant */
+		omap3_pmu_emu_clk = NULL;
+		return 0;
+	}
+
+	ret = clk_enable(omap3_pmu_emu_clk);
+	if (ret) {
+		clk_put(omap3_pmu_emu_clk);
+		omap3_pmu_emu_clk = NULL;
+	}
+
+	return ret;
+}
+
+static void omap3_pmu_release(struct platform_device *pdev)
+{
+	if (!omap3_pmu_emu_clk)
+		return;
+
+	clk_disable(omap3_pmu_emu_clk);
+	clk_put(omap3_pmu_emu_clk);
+	omap3_pmu_emu_clk = NULL;
+}
+
+static struct arm_pmu_platdata omap3_pmu_data = {
+	.reserve	= omap3_pmu_reserve,
+	.release	= omap3_pmu_release,
+};
+
 static struct platform_device omap_pmu_device = {
 	.name		= "arm-pmu",
 	.id		= ARM_PMU_DEVICE_CPU,
@@ -560,12 +603,14 @@ static struct platform_device omap_pmu_device = {
 
 static void omap_init_pmu(void)
 {
-	if (cpu_is_omap24xx())
+	if (cpu_is_omap24xx()) {
 		omap_pmu_device.resource = &omap2_pmu_resource;
-	else if (cpu_is_omap34xx())
+	} else if (cpu_is_omap34xx()) {
 		omap_pmu_device.resource = &omap3_pmu_resource;
-	else
+		omap_pmu_device.dev.platform_data = &omap3_pmu_data;
+	} else {
 		return;
+	}
 
 	platform_device_register(&omap_pmu_device);
 }
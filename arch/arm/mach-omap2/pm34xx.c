@@ -50,6 +50,7 @@
 #include "pm.h"
 #include "sdrc.h"
 #include "control.h"
+#include "timer-gp.h"
 
 #ifdef CONFIG_SUSPEND
 static suspend_state_t suspend_state = PM_SUSPEND_ON;
@@ -405,6 +406,10 @@ void omap_sram_idle(void)
 			if (try_acquire_console_sem())
 				goto console_still_active;
 
+	if (per_next_state < PWRDM_POWER_ON ||
+	    core_next_state < PWRDM_POWER_ON)
+		omap2_gp_clocksource_prepare_idle();
+
 	/* PER */
 	if (per_next_state < PWRDM_POWER_ON) {
 		per_going_off = (per_next_state == PWRDM_POWER_OFF) ? 1 : 0;
@@ -502,6 +507,8 @@ void omap_sram_idle(void)
 		omap_uart_resume_idle(3);
 	}
 
+	omap2_gp_clocksource_resume_idle();
+
 	if (!is_suspending())
 		release_console_sem();
 
@@ -35,8 +35,11 @@
 #include <linux/irq.h>
 #include <linux/clocksource.h>
 #include <linux/clockchips.h>
+#include <linux/cnt32_to_63.h>
+#include <linux/timer.h>
 
 #include <asm/mach/time.h>
+#include <plat/common.h>
 #include <plat/dmtimer.h>
 #include <asm/localtimer.h>
 
@@ -172,7 +175,7 @@ static void __init omap2_gp_clockevent_init(void)
 
 /* Clocksource code */
 
-#ifdef CONFIG_OMAP_32K_TIMER
+#if defined(CONFIG_OMAP_32K_TIMER) && !defined(CONFIG_OMAP_GPTIMER_CLOCKSOURCE)
 /* 
  * When 32k-timer is enabled, don't use GPTimer for clocksource
  * instead, just leave default clocksource which uses the 32k
@@ -185,9 +188,87 @@ static inline void __init omap2_gp_clocksource_init(void) {}
  * clocksource
  */
 static struct omap_dm_timer *gpt_clocksource;
+
+#ifdef CONFIG_OMAP_GPTIMER_CLOCKSOURCE
+static u32 gpt_clocksource_rate;
+
+/*
+ * The GPTIMER loses its context, and keeps PER/CORE from sleeping, so
+ * it's stopped around low power idle.  Meanwhile its count is carried
+ * on the 32k sync counter, sampled on a 32k edge so no fraction of a
+ * tick is dropped each time round.
+ */
+static bool gpt_clocksource_idle;
+static u32 gpt_idle_count;
+static u32 gpt_idle_32k;
+
+static u32 omap_32k_sync_edge(void)
+{
+	u32 t = omap_32k_sync_read();
+
+	while (omap_32k_sync_read() == t)
+		cpu_relax();
+
+	return t + 1;
+}
+
+static u32 gpt_count_at(u32 t32k)
+{
+	u64 delta = (u32)(t32k - gpt_idle_32k);
+
+	return gpt_idle_count + (u32)((delta * gpt_clocksource_rate) >> 15);
+}
+
+static inline u32 gpt_clocksource_count(void)
+{
+	if (unlikely(gpt_clocksource_idle))
+		return gpt_count_at(omap_32k_sync_read());
+
+	return omap_dm_timer_read_counter(gpt_clocksource);
+}
+
+/* Called with interrupts off, before PER or CORE may leave ON */
+void omap2_gp_clocksource_prepare_idle(void)
+{
+	if (!gpt_clocksource || gpt_clocksource_idle)
+		return;
+
+	gpt_idle_32k = omap_32k_sync_edge();
+	gpt_idle_count = omap_dm_timer_read_counter(gpt_clocksource);
+	gpt_clocksource_idle = true;
+
+	omap_dm_timer_stop(gpt_clocksource);
+	omap_dm_timer_disable(gpt_clocksource);
+}
+
+void omap2_gp_clocksource_resume_idle(void)
+{
+	u32 count;
+
+	if (!gpt_clocksource_idle)
+		return;
+
+	omap_dm_timer_enable(gpt_clocksource);
+	count = gpt_count_at(omap_32k_sync_edge());
+
+	/*
+	 * The timer may have been through OFF: reprogram it from scratch.
+	 * Its clock source selection lives in CM and was restored already.
+	 */
+	omap_dm_timer_set_load_start(gpt_clocksource, 1, 0);
+	omap_dm_timer_write_counter(gpt_clocksource, count);
+	gpt_clocksource_idle = false;
+}
+#else
+static inline u32 gpt_clocksource_count(void)
+{
+	return omap_dm_timer_read_counter(gpt_clocksource);
+}
+#endif
+
 static cycle_t clocksource_read_cycles(struct clocksource *cs)
 {
-	return (cycle_t)omap_dm_timer_read_counter(gpt_clocksource);
+	return (cycle_t)gpt_clocksource_count();
 }
 
 static struct clocksource clocksource_gpt = {
@@ -199,6 +280,64 @@ static struct clocksource clocksource_gpt = {
 	.flags		= CLOCK_SOURCE_IS_CONTINUOUS,
 };
 
+#ifdef CONFIG_OMAP_GPTIMER_CLOCKSOURCE
+/*
+ * sched_clock() from the same free running GPTIMER.  cnt32_to_63()
+ * extends it to 63 bits, which needs sched_clock() to be called at
+ * least once per half wrap (~82s at 26MHz).  With NO_HZ a CPU can stay
+ * idle for longer than that, so a timer makes sure of it.
+ */
+#define GPT_NS_SCALE_SHIFT	10
+
+static unsigned long gpt_ns_scale;
+
+static struct timer_list cnt32_to_63_keepwarm_timer;
+
+static void cnt32_to_63_keepwarm(unsigned long data)
+{
+	mod_timer(&cnt32_to_63_keepwarm_timer, round_jiffies(jiffies + data));
+	(void) sched_clock();
+}
+
+static void __init omap2_gp_sched_clock_init(u32 rate)
+{
+	unsigned long long v = (unsigned long long)NSEC_PER_SEC <<
+				GPT_NS_SCALE_SHIFT;
+	unsigned long data;
+
+	do_div(v, rate);
+	gpt_clocksource_rate = rate;
+	gpt_ns_scale = v;
+	/* even, so the flag bit cnt32_to_63() leaves in bit 63 drops out */
+	if (gpt_ns_scale & 1)
+		gpt_ns_scale++;
+
+	/* half the wrap period, less the slack round_jiffies() may add */
+	data = (0xffffffffUL / rate / 2 - 2) * HZ;
+	setup_timer(&cnt32_to_63_keepwarm_timer, cnt32_to_63_keepwarm, data);
+	mod_timer(&cnt32_to_63_keepwarm_timer, round_jiffies(jiffies + data));
+
+	pr_info("OMAP sched_clock: GPTIMER at %u Hz\n", rate);
+}
+
+/*
+ * Returns current time from boot in nsecs. It's OK for this to wrap
+ * around for now, as it's just a relative time stamp.
+ */
+unsigned long long notrace sched_clock(void)
+{
+	unsigned long long v;
+
+	if (unlikely(!gpt_ns_scale))
+		return 0;
+
+	v = cnt32_to_63(gpt_clocksource_count());
+	return (v * gpt_ns_scale) >> GPT_NS_SCALE_SHIFT;
+}
+#else
+static inline void __init omap2_gp_sched_clock_init(u32 rate) {}
+#endif
+
 /* Setup free-running counter for clocksource */
 static void __init omap2_gp_clocksource_init(void)
 {
@@ -216,13 +355,14 @@ static void __init omap2_gp_clocksource_init(void)
 
 	omap_dm_timer_set_source(gpt, OMAP_TIMER_SRC_SYS_CLK);
 	tick_rate = clk_get_rate(omap_dm_timer_get_fclk(gpt));
-
 	omap_dm_timer_set_load_start(gpt, 1, 0);
 
 	clocksource_gpt.mult =
 		clocksource_khz2mult(tick_rate/1000, clocksource_gpt.shift);
 	if (clocksource_register(&clocksource_gpt))
 		printk(err2, clocksource_gpt.name);
+
+	omap2_gp_sched_clock_init(tick_rate);
 }
 #endif
 
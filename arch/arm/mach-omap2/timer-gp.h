@@ -13,4 +13,12 @@
 
 extern int __init omap2_gp_clockevent_set_gptimer(u8 id);
 
+#ifdef CONFIG_OMAP_GPTIMER_CLOCKSOURCE
+extern void omap2_gp_clocksource_prepare_idle(void);
+extern void omap2_gp_clocksource_resume_idle(void);
+#else
+static inline void omap2_gp_clocksource_prepare_idle(void) { }
+static inline void omap2_gp_clocksource_resume_idle(void) { }
+#endif
+
 #endif
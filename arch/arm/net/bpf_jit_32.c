@@ -0,0 +1,748 @@
+/*
+ * Just-In-Time compiler for BPF filters on 32bit ARM
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#include <linux/bitops.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/log2.h>
+#include <linux/moduleloader.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/filter.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <asm/cacheflush.h>
+#include <asm/hwcap.h>
+#include <asm/unaligned.h>
+
+#include "bpf_jit_32.h"
+
+/*
+ * ABI:
+ *
+ * r0	scratch register, filter result
+ * r1	packet offset handed to the load helpers
+ * r2	scratch register
+ * r3	scratch register, address of the called helper
+ * r4	BPF register A
+ * r5	BPF register X
+ * r6	pointer to the skb
+ * r7	skb->data
+ * r8	skb_headlen(skb)
+ *
+ * The scratch memory store lives on the stack.
+ */
+
+#define r_scratch	ARM_R0
+#define r_off		ARM_R1
+#define r_A		ARM_R4
+#define r_X		ARM_R5
+#define r_skb		ARM_R6
+#define r_skb_data	ARM_R7
+#define r_skb_hl	ARM_R8
+
+/* an even number of registers keeps the stack 8 byte aligned */
+#define SAVED_REGS	(1 << r_A | 1 << r_X | 1 << r_skb | \
+			 1 << r_skb_data | 1 << r_skb_hl | 1 << ARM_LR)
+
+/* the load helpers return the loaded value and an error flag in a u64 */
+#ifdef __ARMEB__
+#define r_ret_err	ARM_R0
+#define r_ret_val	ARM_R1
+#else
+#define r_ret_val	ARM_R0
+#define r_ret_err	ARM_R1
+#endif
+
+#define SCRATCH_SIZE	(BPF_MEMWORDS * 4)
+#define SCRATCH_OFF(k)	((k) * 4)
+
+#define SEEN_MEM	(1 << 0)	/* uses the scratch memory store */
+#define SEEN_DATA	(1 << 1)	/* reads packet data */
+#define SEEN_IND	(1 << 2)	/* has indirect packet loads */
+
+/*
+ * The load helpers return the loaded value in the low word and a status
+ * in the high word. An indirect load can land in the ancillary range,
+ * which only the interpreter knows how to read.
+ */
+#define LOAD_FAILED	((u64)1 << 32)
+#define LOAD_ANC	((u64)2 << 32)
+
+int bpf_jit_enable __read_mostly;
+
+struct jit_ctx {
+	const struct sk_filter *skf;
+	unsigned idx;
+	unsigned prologue_len;
+	unsigned epilogue_off;
+	unsigned fallback_off;
+	u32 seen;
+	u32 mem_read;
+	u32 *offsets;
+	u32 *target;
+};
+
+static u64 jit_get_skb_b(struct sk_buff *skb, int offset)
+{
+	u8 *ptr, tmp;
+
+	if (offset < 0 && offset >= SKF_AD_OFF)
+		return LOAD_ANC;
+	ptr = bpf_load_pointer(skb, offset, 1, &tmp);
+	if (ptr == NULL)
+		return LOAD_FAILED;
+	return *ptr;
+}
+
+static u64 jit_get_skb_h(struct sk_buff *skb, int offset)
+{
+	u16 *ptr, tmp;
+
+	if (offset < 0 && offset >= SKF_AD_OFF)
+		return LOAD_ANC;
+	ptr = bpf_load_pointer(skb, offset, 2, &tmp);
+	if (ptr == NULL)
+		return LOAD_FAILED;
+	return get_unaligned_be16(ptr);
+}
+
+static u64 jit_get_skb_w(struct sk_buff *skb, int offset)
+{
+	u32 *ptr, tmp;
+
+	if (offset < 0 && offset >= SKF_AD_OFF)
+		return LOAD_ANC;
+	ptr = bpf_load_pointer(skb, offset, 4, &tmp);
+	if (ptr == NULL)
+		return LOAD_FAILED;
+	return get_unaligned_be32(ptr);
+}
+
+/* there is no divide instruction before the ARMv7 virtualization cores */
+static u32 jit_udiv(u32 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static u64 (*load_func[])(struct sk_buff *, int) = {
+	jit_get_skb_b,
+	jit_get_skb_h,
+	jit_get_skb_w,
+};
+
+static inline void _emit(int cond, u32 inst, struct jit_ctx *ctx)
+{
+	if (ctx->target != NULL)
+		ctx->target[ctx->idx] = inst | (cond << 28);
+
+	ctx->idx++;
+}
+
+static inline void emit(u32 inst, struct jit_ctx *ctx)
+{
+	_emit(ARM_COND_AL, inst, ctx);
+}
+
+/*
+ * Encode @x as a data processing immediate, an 8 bit value rotated right
+ * by an even amount. Returns -1 if there is no such encoding.
+ */
+static int imm8m(u32 x)
+{
+	u32 rot;
+
+	if (x <= 0xff)
+		return x;
+
+	for (rot = 1; rot < 16; rot++)
+		if ((x & ~ror32(0xff, 2 * rot)) == 0)
+			return rol32(x, 2 * rot) | (rot << 8);
+
+	return -1;
+}
+
+static void emit_mov_i(int rd, u32 val, struct jit_ctx *ctx)
+{
+	int imm12;
+#if __LINUX_ARM_ARCH__ < 7
+	int shift;
+#endif
+
+	imm12 = imm8m(val);
+	if (imm12 >= 0) {
+		emit(ARM_MOV_I(rd, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(~val);
+	if (imm12 >= 0) {
+		emit(ARM_MVN_I(rd, imm12), ctx);
+		return;
+	}
+
+#if __LINUX_ARM_ARCH__ < 7
+	/* build it a byte at a time, each byte is a valid immediate */
+	emit(ARM_MOV_I(rd, val & 0xff), ctx);
+	for (shift = 8; shift < 32; shift += 8)
+		if (val & (0xff << shift))
+			emit(ARM_ORR_I(rd, rd, imm8m(val & (0xff << shift))),
+			     ctx);
+#else
+	emit(ARM_MOVW(rd, val & 0xffff), ctx);
+	if (val > 0xffff)
+		emit(ARM_MOVT(rd, val >> 16), ctx);
+#endif
+}
+
+/*
+ * Emit "op rd, rn, #k", going through r_scratch when @k cannot be encoded
+ * as an immediate. The compare instructions pass rd == 0.
+ */
+static void emit_op_k(u32 op_i, u32 op_r, int rd, int rn, u32 k,
+		      struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(k);
+
+	if (imm12 >= 0) {
+		emit(op_i | rd << 12 | rn << 16 | imm12, ctx);
+	} else {
+		emit_mov_i(r_scratch, k, ctx);
+		emit(op_r | rd << 12 | rn << 16 | r_scratch, ctx);
+	}
+}
+
+static inline void emit_blx_r(int tgt_reg, struct jit_ctx *ctx)
+{
+#if __LINUX_ARM_ARCH__ < 5
+	emit(ARM_MOV_R(ARM_LR, ARM_PC), ctx);
+
+	if (elf_hwcap & HWCAP_THUMB)
+		emit(ARM_BX(tgt_reg), ctx);
+	else
+		emit(ARM_MOV_R(ARM_PC, tgt_reg), ctx);
+#else
+	emit(ARM_BLX_R(tgt_reg), ctx);
+#endif
+}
+
+static inline void emit_ret(struct jit_ctx *ctx)
+{
+#if __LINUX_ARM_ARCH__ < 5
+	if (!(elf_hwcap & HWCAP_THUMB)) {
+		emit(ARM_MOV_R(ARM_PC, ARM_LR), ctx);
+		return;
+	}
+#endif
+	emit(ARM_BX(ARM_LR), ctx);
+}
+
+/* branch offset from the current instruction to BPF instruction @tgt */
+static inline int b_imm(unsigned tgt, struct jit_ctx *ctx)
+{
+	/* PC reads as the address of the instruction + 8 */
+	return (int)(ctx->prologue_len + ctx->offsets[tgt]) -
+	       (int)(ctx->idx + 2);
+}
+
+static inline int b_epilogue(struct jit_ctx *ctx)
+{
+	return (int)ctx->epilogue_off - (int)(ctx->idx + 2);
+}
+
+static inline int b_fallback(struct jit_ctx *ctx)
+{
+	return (int)ctx->fallback_off - (int)(ctx->idx + 2);
+}
+
+/* return 0 from the filter if the condition holds */
+static inline void emit_err_ret(int cond, struct jit_ctx *ctx)
+{
+	_emit(cond, ARM_MOV_I(ARM_R0, 0), ctx);
+	_emit(cond, ARM_B(b_epilogue(ctx)), ctx);
+}
+
+static void emit_udiv(struct jit_ctx *ctx)
+{
+	/* the divisor is already in r1 */
+	emit(ARM_MOV_R(ARM_R0, r_A), ctx);
+	emit_mov_i(ARM_R3, (u32)jit_udiv, ctx);
+	emit_blx_r(ARM_R3, ctx);
+	emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+}
+
+/*
+ * Load the big endian value of 1 << @order bytes at r3 into r0. Byte
+ * loads keep us clear of the alignment trap, packet headers are rarely
+ * word aligned.
+ */
+static void emit_load_be(int cond, unsigned order, struct jit_ctx *ctx)
+{
+	switch (order) {
+	case 0:
+		_emit(cond, ARM_LDRB_I(ARM_R0, ARM_R3, 0), ctx);
+		break;
+	case 1:
+		_emit(cond, ARM_LDRB_I(ARM_R0, ARM_R3, 0), ctx);
+		_emit(cond, ARM_LDRB_I(ARM_R1, ARM_R3, 1), ctx);
+		_emit(cond, ARM_ORR_SR(ARM_R0, ARM_R1, ARM_R0, SRTYPE_LSL, 8),
+		      ctx);
+		break;
+	case 2:
+		_emit(cond, ARM_LDRB_I(ARM_R0, ARM_R3, 0), ctx);
+		_emit(cond, ARM_LDRB_I(ARM_R1, ARM_R3, 1), ctx);
+		_emit(cond, ARM_LDRB_I(ARM_R2, ARM_R3, 2), ctx);
+		_emit(cond, ARM_LDRB_I(ARM_R3, ARM_R3, 3), ctx);
+		_emit(cond, ARM_ORR_SR(ARM_R0, ARM_R3, ARM_R0, SRTYPE_LSL, 24),
+		      ctx);
+		_emit(cond, ARM_ORR_SR(ARM_R0, ARM_R0, ARM_R1, SRTYPE_LSL, 16),
+		      ctx);
+		_emit(cond, ARM_ORR_SR(ARM_R0, ARM_R0, ARM_R2, SRTYPE_LSL, 8),
+		      ctx);
+		break;
+	}
+}
+
+/*
+ * Load 1 << @order bytes at packet offset r_off into r_scratch. Reads
+ * within the linear part of the skb are done inline when @linear is set,
+ * everything else goes through the C helpers. A failed load returns 0
+ * from the filter, as the interpreter does. An indirect (@ind) load that
+ * reaches the ancillary range hands the packet to the interpreter.
+ */
+static void emit_load(unsigned order, bool linear, bool ind,
+		      struct jit_ctx *ctx)
+{
+	int cond = ARM_COND_AL;
+	unsigned join = 0;
+
+	ctx->seen |= SEEN_DATA;
+
+	if (linear) {
+		if (order == 0) {
+			emit(ARM_CMP_R(r_skb_hl, r_off), ctx);
+			cond = ARM_COND_HI;
+		} else {
+			/* the compare is skipped when headlen < size */
+			emit(ARM_SUBS_I(ARM_R2, r_skb_hl, 1 << order), ctx);
+			_emit(ARM_COND_HS, ARM_CMP_R(ARM_R2, r_off), ctx);
+			cond = ARM_COND_HS;
+		}
+		_emit(cond, ARM_ADD_R(ARM_R3, r_skb_data, r_off), ctx);
+		emit_load_be(cond, order, ctx);
+
+		/* patched below, once the slow path length is known */
+		join = ctx->idx;
+		_emit(cond, ARM_B(0), ctx);
+	}
+
+	/* the slow path, the offset is already in r1 */
+	emit(ARM_MOV_R(ARM_R0, r_skb), ctx);
+	emit_mov_i(ARM_R3, (u32)load_func[order], ctx);
+	emit_blx_r(ARM_R3, ctx);
+	if (ind) {
+		emit(ARM_CMP_I(r_ret_err, LOAD_FAILED >> 32), ctx);
+		emit_err_ret(ARM_COND_EQ, ctx);
+		_emit(ARM_COND_HI, ARM_B(b_fallback(ctx)), ctx);
+	} else {
+		emit(ARM_CMP_I(r_ret_err, 0), ctx);
+		emit_err_ret(ARM_COND_NE, ctx);
+	}
+	if (r_ret_val != r_scratch)
+		emit(ARM_MOV_R(r_scratch, r_ret_val), ctx);
+
+	if (linear && ctx->target != NULL)
+		ctx->target[join] = ARM_B(ctx->idx - (join + 2)) | cond << 28;
+}
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	int i;
+
+	emit(ARM_PUSH(SAVED_REGS), ctx);
+	emit(ARM_MOV_R(r_skb, ARM_R0), ctx);
+
+	if (ctx->seen & SEEN_DATA) {
+		emit(ARM_LDR_I(r_skb_data, r_skb,
+			       offsetof(struct sk_buff, data)), ctx);
+		emit(ARM_LDR_I(r_skb_hl, r_skb,
+			       offsetof(struct sk_buff, len)), ctx);
+		emit(ARM_LDR_I(r_scratch, r_skb,
+			       offsetof(struct sk_buff, data_len)), ctx);
+		emit(ARM_SUB_R(r_skb_hl, r_skb_hl, r_scratch), ctx);
+	}
+
+	emit(ARM_MOV_I(r_A, 0), ctx);
+	emit(ARM_MOV_I(r_X, 0), ctx);
+
+	if (ctx->seen & SEEN_MEM) {
+		emit(ARM_SUB_I(ARM_SP, ARM_SP, SCRATCH_SIZE), ctx);
+
+		/* the interpreter reads words never stored to as zero */
+		if (ctx->mem_read) {
+			emit(ARM_MOV_I(r_scratch, 0), ctx);
+			for (i = 0; i < BPF_MEMWORDS; i++)
+				if (ctx->mem_read & (1 << i))
+					emit(ARM_STR_I(r_scratch, ARM_SP,
+						       SCRATCH_OFF(i)), ctx);
+		}
+	}
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	if (ctx->seen & SEEN_MEM)
+		emit(ARM_ADD_I(ARM_SP, ARM_SP, SCRATCH_SIZE), ctx);
+
+	emit(ARM_POP(SAVED_REGS), ctx);
+	emit_ret(ctx);
+
+	/*
+	 * Filters have no side effects, so when an indirect load hits
+	 * ancillary data the interpreter can rerun the whole filter and
+	 * its verdict is ours.
+	 */
+	if (ctx->seen & SEEN_IND) {
+		ctx->fallback_off = ctx->idx;
+		emit(ARM_MOV_R(ARM_R0, r_skb), ctx);
+		emit_mov_i(ARM_R1, (u32)ctx->skf->insns, ctx);
+		emit_mov_i(ARM_R2, ctx->skf->len, ctx);
+		emit_mov_i(ARM_R3, (u32)sk_run_filter, ctx);
+		emit_blx_r(ARM_R3, ctx);
+		emit(ARM_B(b_epilogue(ctx)), ctx);
+	}
+}
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct sk_filter *prog = ctx->skf;
+	const struct sock_filter *inst;
+	unsigned i, order;
+	int cond;
+	u32 k;
+
+	for (i = 0; i < prog->len; i++) {
+		inst = &prog->insns[i];
+		k = inst->k;
+
+		/* the first pass records where each instruction starts */
+		if (ctx->target == NULL)
+			ctx->offsets[i] = ctx->idx;
+
+		switch (inst->code) {
+		case BPF_S_LD_IMM:
+			emit_mov_i(r_A, k, ctx);
+			break;
+		case BPF_S_LD_W_LEN:
+			emit(ARM_LDR_I(r_A, r_skb,
+				       offsetof(struct sk_buff, len)), ctx);
+			break;
+		case BPF_S_LD_MEM:
+			ctx->seen |= SEEN_MEM;
+			ctx->mem_read |= 1 << k;
+			emit(ARM_LDR_I(r_A, ARM_SP, SCRATCH_OFF(k)), ctx);
+			break;
+		case BPF_S_LD_W_ABS:
+			order = 2;
+			goto load;
+		case BPF_S_LD_H_ABS:
+			order = 1;
+			goto load;
+		case BPF_S_LD_B_ABS:
+			order = 0;
+load:
+			/* ancillary data is left to the interpreter */
+			if ((int)k < 0 && (int)k >= SKF_AD_OFF)
+				return -ENOTSUPP;
+			emit_mov_i(r_off, k, ctx);
+			emit_load(order, (int)k >= 0, false, ctx);
+			emit(ARM_MOV_R(r_A, r_scratch), ctx);
+			break;
+		case BPF_S_LD_W_IND:
+			order = 2;
+			goto load_ind;
+		case BPF_S_LD_H_IND:
+			order = 1;
+			goto load_ind;
+		case BPF_S_LD_B_IND:
+			order = 0;
+load_ind:
+			ctx->seen |= SEEN_IND;
+			emit_op_k(ARM_INST_ADD_I, ARM_INST_ADD_R, r_off, r_X, k,
+				  ctx);
+			emit_load(order, true, true, ctx);
+			emit(ARM_MOV_R(r_A, r_scratch), ctx);
+			break;
+		case BPF_S_LDX_IMM:
+			emit_mov_i(r_X, k, ctx);
+			break;
+		case BPF_S_LDX_W_LEN:
+			emit(ARM_LDR_I(r_X, r_skb,
+				       offsetof(struct sk_buff, len)), ctx);
+			break;
+		case BPF_S_LDX_MEM:
+			ctx->seen |= SEEN_MEM;
+			ctx->mem_read |= 1 << k;
+			emit(ARM_LDR_I(r_X, ARM_SP, SCRATCH_OFF(k)), ctx);
+			break;
+		case BPF_S_LDX_B_MSH:
+			/* X = ((*(u8 *)(skb->data + k)) & 0xf) << 2 */
+			if ((int)k < 0 && (int)k >= SKF_AD_OFF)
+				return -ENOTSUPP;
+			emit_mov_i(r_off, k, ctx);
+			emit_load(0, (int)k >= 0, false, ctx);
+			emit(ARM_AND_I(r_scratch, r_scratch, 0x0f), ctx);
+			emit(ARM_LSL_I(r_X, r_scratch, 2), ctx);
+			break;
+		case BPF_S_ST:
+			ctx->seen |= SEEN_MEM;
+			emit(ARM_STR_I(r_A, ARM_SP, SCRATCH_OFF(k)), ctx);
+			break;
+		case BPF_S_STX:
+			ctx->seen |= SEEN_MEM;
+			emit(ARM_STR_I(r_X, ARM_SP, SCRATCH_OFF(k)), ctx);
+			break;
+		case BPF_S_ALU_ADD_K:
+			emit_op_k(ARM_INST_ADD_I, ARM_INST_ADD_R, r_A, r_A, k,
+				  ctx);
+			break;
+		case BPF_S_ALU_ADD_X:
+			emit(ARM_ADD_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_SUB_K:
+			emit_op_k(ARM_INST_SUB_I, ARM_INST_SUB_R, r_A, r_A, k,
+				  ctx);
+			break;
+		case BPF_S_ALU_SUB_X:
+			emit(ARM_SUB_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_MUL_K:
+			/* Rd and Rm have to differ before ARMv6 */
+			emit_mov_i(r_scratch, k, ctx);
+			emit(ARM_MUL(r_A, r_scratch, r_A), ctx);
+			break;
+		case BPF_S_ALU_MUL_X:
+			emit(ARM_MUL(r_A, r_X, r_A), ctx);
+			break;
+		case BPF_S_ALU_DIV_K:
+			/* sk_chk_filter() rejects k == 0 */
+			if (k == 1)
+				break;
+			if (is_power_of_2(k)) {
+				emit(ARM_LSR_I(r_A, r_A, ilog2(k)), ctx);
+				break;
+			}
+			emit_mov_i(ARM_R1, k, ctx);
+			emit_udiv(ctx);
+			break;
+		case BPF_S_ALU_DIV_X:
+			emit(ARM_CMP_I(r_X, 0), ctx);
+			emit_err_ret(ARM_COND_EQ, ctx);
+			emit(ARM_MOV_R(ARM_R1, r_X), ctx);
+			emit_udiv(ctx);
+			break;
+		case BPF_S_ALU_AND_K:
+			emit_op_k(ARM_INST_AND_I, ARM_INST_AND_R, r_A, r_A, k,
+				  ctx);
+			break;
+		case BPF_S_ALU_AND_X:
+			emit(ARM_AND_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_OR_K:
+			emit_op_k(ARM_INST_ORR_I, ARM_INST_ORR_R, r_A, r_A, k,
+				  ctx);
+			break;
+		case BPF_S_ALU_OR_X:
+			emit(ARM_ORR_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_LSH_K:
+			/*
+			 * Out of range shifts go through a register shift,
+			 * which is what the interpreter compiles to.
+			 */
+			if (k < 32) {
+				emit(ARM_LSL_I(r_A, r_A, k), ctx);
+			} else {
+				emit_mov_i(r_scratch, k, ctx);
+				emit(ARM_LSL_R(r_A, r_A, r_scratch), ctx);
+			}
+			break;
+		case BPF_S_ALU_LSH_X:
+			emit(ARM_LSL_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_RSH_K:
+			/* an immediate LSR #0 means LSR #32 */
+			if (k == 0)
+				break;
+			if (k < 32) {
+				emit(ARM_LSR_I(r_A, r_A, k), ctx);
+			} else {
+				emit_mov_i(r_scratch, k, ctx);
+				emit(ARM_LSR_R(r_A, r_A, r_scratch), ctx);
+			}
+			break;
+		case BPF_S_ALU_RSH_X:
+			emit(ARM_LSR_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_NEG:
+			emit(ARM_RSB_I(r_A, r_A, 0), ctx);
+			break;
+		case BPF_S_JMP_JA:
+			emit(ARM_B(b_imm(i + k + 1, ctx)), ctx);
+			break;
+		case BPF_S_JMP_JEQ_K:
+			cond = ARM_COND_EQ;
+			goto cmp_imm;
+		case BPF_S_JMP_JGT_K:
+			cond = ARM_COND_HI;
+			goto cmp_imm;
+		case BPF_S_JMP_JGE_K:
+			cond = ARM_COND_HS;
+cmp_imm:
+			emit_op_k(ARM_INST_CMP_I, ARM_INST_CMP_R, 0, r_A, k,
+				  ctx);
+			goto cond_jump;
+		case BPF_S_JMP_JSET_K:
+			cond = ARM_COND_NE;
+			emit_op_k(ARM_INST_TST_I, ARM_INST_TST_R, 0, r_A, k,
+				  ctx);
+			goto cond_jump;
+		case BPF_S_JMP_JEQ_X:
+			cond = ARM_COND_EQ;
+			goto cmp_x;
+		case BPF_S_JMP_JGT_X:
+			cond = ARM_COND_HI;
+			goto cmp_x;
+		case BPF_S_JMP_JGE_X:
+			cond = ARM_COND_HS;
+cmp_x:
+			emit(ARM_CMP_R(r_A, r_X), ctx);
+			goto cond_jump;
+		case BPF_S_JMP_JSET_X:
+			cond = ARM_COND_NE;
+			emit(ARM_TST_R(r_A, r_X), ctx);
+cond_jump:
+			if (inst->jt == inst->jf) {
+				if (inst->jt)
+					emit(ARM_B(b_imm(i + inst->jt + 1,
+							 ctx)), ctx);
+				break;
+			}
+			/* the inverse of an ARM condition is cond ^ 1 */
+			if (inst->jt)
+				_emit(cond, ARM_B(b_imm(i + inst->jt + 1,
+							ctx)), ctx);
+			if (inst->jf)
+				_emit(cond ^ 1, ARM_B(b_imm(i + inst->jf + 1,
+							    ctx)), ctx);
+			break;
+		case BPF_S_RET_K:
+			emit_mov_i(ARM_R0, k, ctx);
+			goto ret;
+		case BPF_S_RET_A:
+			emit(ARM_MOV_R(ARM_R0, r_A), ctx);
+ret:
+			/* the last instruction falls into the epilogue */
+			if (i != prog->len - 1)
+				emit(ARM_B(b_epilogue(ctx)), ctx);
+			break;
+		case BPF_S_MISC_TAX:
+			emit(ARM_MOV_R(r_X, r_A), ctx);
+			break;
+		case BPF_S_MISC_TXA:
+			emit(ARM_MOV_R(r_A, r_X), ctx);
+			break;
+		default:
+			return -ENOTSUPP;
+		}
+	}
+
+	return 0;
+}
+
+void bpf_jit_compile(struct sk_filter *fp)
+{
+	struct jit_ctx ctx;
+	unsigned body_len;
+	unsigned alloc_size;
+
+	if (!bpf_jit_enable)
+		return;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.skf = fp;
+
+	ctx.offsets = kzalloc(fp->len * sizeof(*ctx.offsets), GFP_KERNEL);
+	if (ctx.offsets == NULL)
+		return;
+
+	/*
+	 * The first pass only counts instructions, which gives us the
+	 * instruction offsets and the registers the prologue has to set up.
+	 * Every construct has a fixed length, so the second pass lays the
+	 * code out exactly the same way.
+	 */
+	if (build_body(&ctx))
+		goto out;
+
+	body_len = ctx.idx;
+	ctx.idx = 0;
+	build_prologue(&ctx);
+	ctx.prologue_len = ctx.idx;
+	ctx.epilogue_off = ctx.prologue_len + body_len;
+
+	ctx.idx = ctx.epilogue_off;
+	build_epilogue(&ctx);
+
+	/* bpf_jit_free() reuses the image to defer the vfree() */
+	alloc_size = max_t(unsigned, ctx.idx * 4, sizeof(struct work_struct));
+	ctx.target = module_alloc(alloc_size);
+	if (ctx.target == NULL)
+		goto out;
+
+	ctx.idx = 0;
+	build_prologue(&ctx);
+	build_body(&ctx);
+	build_epilogue(&ctx);
+
+	flush_icache_range((u32)ctx.target, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1) {
+		pr_info("flen=%d proglen=%u image=%p\n",
+			fp->len, ctx.idx * 4, ctx.target);
+		print_hex_dump(KERN_INFO, "JIT code: ", DUMP_PREFIX_ADDRESS,
+			       16, 4, ctx.target, ctx.idx * 4, false);
+	}
+
+	fp->bpf_func = (void *)ctx.target;
+out:
+	kfree(ctx.offsets);
+}
+
+static void bpf_jit_free_worker(struct work_struct *work)
+{
+	module_free(NULL, work);
+}
+
+void bpf_jit_free(struct sk_filter *fp)
+{
+	struct work_struct *work;
+
+	if (fp->bpf_func == sk_run_filter)
+		return;
+
+	/*
+	 * We are called from an RCU callback where vfree() is not allowed,
+	 * so hand the image over to a workqueue. The image is dead by now
+	 * and is big enough to hold the work_struct itself.
+	 */
+	work = (struct work_struct *)fp->bpf_func;
+	INIT_WORK(work, bpf_jit_free_worker);
+	schedule_work(work);
+}
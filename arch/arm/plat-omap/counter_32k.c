@@ -108,6 +108,16 @@ static struct clocksource clocksource_32k = {
 	.flags		= CLOCK_SOURCE_IS_CONTINUOUS,
 };
 
+/*
+ * Raw 32k count since boot, for code that needs a time base which
+ * keeps running through every idle state.
+ */
+u32 omap_32k_sync_read(void)
+{
+	return clocksource_32k.read(&clocksource_32k);
+}
+
+#ifndef CONFIG_OMAP_GPTIMER_CLOCKSOURCE
 /*
  * Returns current time from boot in nsecs. It's OK for this to wrap
  * around for now, as it's just a relative time stamp.
@@ -117,6 +127,7 @@ unsigned long long sched_clock(void)
 	return clocksource_cyc2ns(clocksource_32k.read(&clocksource_32k),
 				  clocksource_32k.mult, clocksource_32k.shift);
 }
+#endif
 
 /**
  * read_persistent_clock -  Return time from a persistent clock.
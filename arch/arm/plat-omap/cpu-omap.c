@@ -86,9 +86,7 @@ static int omap_target(struct cpufreq_policy *policy,
 		       unsigned int target_freq,
 		       unsigned int relation)
 {
-#ifdef CONFIG_ARCH_OMAP1
 	struct cpufreq_freqs freqs;
-#endif
 #if defined(CONFIG_ARCH_OMAP3)
 	unsigned long freq;
 	struct device *mpu_dev = omap2_get_mpuss_device();
@@ -118,8 +116,24 @@ static int omap_target(struct cpufreq_policy *policy,
 	cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
 #elif defined(CONFIG_ARCH_OMAP3)
 	freq = target_freq * 1000;
-	if (opp_find_freq_ceil(mpu_dev, &freq))
-		omap_device_scale(mpu_dev, mpu_dev, freq);
+	if (IS_ERR(opp_find_freq_ceil(mpu_dev, &freq)))
+		return -EINVAL;
+
+	freqs.old = omap_getspeed(0);
+	freqs.new = freq / 1000;
+	freqs.cpu = 0;
+
+	if (freqs.old == freqs.new)
+		return ret;
+
+	/*
+	 * Let the notifiers (loops_per_jiffy, cpufreq_stats) see OPP
+	 * changes, voltage scaling included.
+	 */
+	cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
+	ret = omap_device_scale(mpu_dev, mpu_dev, freq);
+	freqs.new = omap_getspeed(0);
+	cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
 #endif
 	return ret;
 }
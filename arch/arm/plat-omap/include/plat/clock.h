@@ -97,6 +97,25 @@ struct clksel {
 	const struct clksel_rate *rates;
 };
 
+/* Number of rounded (rate, M, N) results kept per DPLL */
+#define DPLL_ROUNDED_CACHE	4
+
+/**
+ * struct dpll_rounded - cached result of omap2_dpll_round_rate()
+ * @target_rate: rate that was asked for
+ * @ref_rate: reference clock rate the result was computed with
+ * @rate: resulting DPLL rate
+ * @m: DPLL multiplier
+ * @n: DPLL divider
+ */
+struct dpll_rounded {
+	unsigned long		target_rate;
+	unsigned long		ref_rate;
+	unsigned long		rate;
+	u16			m;
+	u8			n;
+};
+
 /**
  * struct dpll_data - DPLL registers and integration data
  * @mult_div1_reg: register containing the DPLL M and N bitfields
@@ -111,6 +130,9 @@ struct clksel {
  * @last_rounded_m: cache of the last M result of omap2_dpll_round_rate()
  * @max_multiplier: maximum valid non-bypass multiplier value (actual)
  * @last_rounded_n: cache of the last N result of omap2_dpll_round_rate()
+ * @rounded: recent omap2_dpll_round_rate() results, so that switching
+ *	back and forth between a handful of rates (OPPs) skips the M/N search
+ * @rounded_next: next slot of @rounded to replace
  * @min_divider: minimum valid non-bypass divider value (actual)
  * @max_divider: maximum valid non-bypass divider value (actual)
  * @modes: possible values of @enable_mask
@@ -136,7 +158,7 @@ struct clksel {
  * don't seem to be any usecases for DPLL rounding that is not exact.
  *
  * XXX The runtime-variable fields (@last_rounded_rate, @last_rounded_m,
- * @last_rounded_n) should be separated from the runtime-fixed fields
+ * @last_rounded_n, @rounded) should be separated from the runtime-fixed fields
  * and placed into a differenct structure, so that the runtime-fixed data
  * can be placed into read-only space.
  */
@@ -156,6 +178,8 @@ struct dpll_data {
 	u8			min_divider;
 	u8			max_divider;
 	u8			modes;
+	u8			rounded_next;
+	struct dpll_rounded	rounded[DPLL_ROUNDED_CACHE];
 #if defined(CONFIG_ARCH_OMAP3) || defined(CONFIG_ARCH_OMAP4)
 	void __iomem		*autoidle_reg;
 	void __iomem		*idlest_reg;
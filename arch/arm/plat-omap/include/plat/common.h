@@ -37,6 +37,7 @@ extern void omap_map_common_io(void);
 extern struct sys_timer omap_timer;
 
 extern void omap_reserve(void);
+extern u32 omap_32k_sync_read(void);
 extern void ti81xx_reserve(void);
 
 /*
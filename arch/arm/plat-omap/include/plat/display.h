@@ -23,6 +23,7 @@
 #include <linux/list.h>
 #include <linux/kobject.h>
 #include <linux/device.h>
+#include <linux/wait.h>
 #include <asm/atomic.h>
 
 #define DISPC_IRQ_FRAMEDONE		(1 << 0)
@@ -309,6 +310,20 @@ struct omap_overlay_manager_info {
 	bool alpha_enabled;
 };
 
+#define OMAP_DSS_FLIP_MAX_OVERLAYS	3
+#define OMAP_DSS_FLIP_QUEUE_MAX		3
+
+/* A page flip: new scanout addresses for one or more overlays of a manager,
+ * taken into use atomically at the same VSYNC */
+struct omap_dss_flip {
+	int num_overlays;
+	struct {
+		struct omap_overlay *ovl;
+		u32 paddr;
+		void __iomem *vaddr;
+	} ovls[OMAP_DSS_FLIP_MAX_OVERLAYS];
+};
+
 struct omap_overlay_manager {
 	struct kobject kobj;
 	struct list_head list;
@@ -329,6 +344,9 @@ struct omap_overlay_manager {
 	/* if true, info has been changed but not applied() yet */
 	bool info_dirty;
 
+	/* woken up each time a queued flip has been taken into use */
+	wait_queue_head_t flip_wait;
+
 	int (*set_device)(struct omap_overlay_manager *mgr,
 		struct omap_dss_device *dssdev);
 	int (*unset_device)(struct omap_overlay_manager *mgr);
@@ -342,6 +360,13 @@ struct omap_overlay_manager {
 	int (*wait_for_go)(struct omap_overlay_manager *mgr);
 	int (*wait_for_vsync)(struct omap_overlay_manager *mgr);
 
+	/* non-blocking page flip queue */
+	int (*queue_flip)(struct omap_overlay_manager *mgr,
+			const struct omap_dss_flip *flip, u32 *seq);
+	int (*get_flip_status)(struct omap_overlay_manager *mgr,
+			u32 *done_seq);
+	int (*wait_for_flip)(struct omap_overlay_manager *mgr, u32 seq);
+
 	int (*enable)(struct omap_overlay_manager *mgr);
 	int (*disable)(struct omap_overlay_manager *mgr);
 };
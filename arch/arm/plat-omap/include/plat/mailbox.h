@@ -48,6 +48,8 @@ struct omap_mbox_queue {
 	struct tasklet_struct	tasklet;
 	struct omap_mbox	*mbox;
 	bool full;
+	/* rx irq disabled, the work handler polls the fifo */
+	bool polling;
 };
 
 struct omap_mbox {
@@ -59,6 +61,7 @@ struct omap_mbox {
 	void			*priv;
 	int			use_count;
 	struct blocking_notifier_head   notifier;
+	struct blocking_notifier_head   bulk_notifier;
 };
 
 int omap_mbox_msg_send(struct omap_mbox *, mbox_msg_t msg);
@@ -66,6 +69,8 @@ void omap_mbox_init_seq(struct omap_mbox *);
 
 struct omap_mbox *omap_mbox_get(const char *, struct notifier_block *nb);
 void omap_mbox_put(struct omap_mbox *mbox, struct notifier_block *nb);
+struct omap_mbox *omap_mbox_get_bulk(const char *, struct notifier_block *nb);
+void omap_mbox_put_bulk(struct omap_mbox *mbox, struct notifier_block *nb);
 
 int omap_mbox_register(struct device *parent, struct omap_mbox **);
 int omap_mbox_unregister(void);
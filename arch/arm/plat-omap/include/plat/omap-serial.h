@@ -51,7 +51,19 @@
 
 #define OMAP_UART_DMA_CH_FREE	-1
 
-#define RX_TIMEOUT		(3 * HZ)
+/* Defaults for the RX DMA ring, see struct omap_uart_port_info */
+#define OMAP_UART_DMA_RX_BUF_SIZE	4096
+#define OMAP_UART_DMA_RX_TIMEOUT	1000	/* usecs */
+
+/*
+ * RX FIFO level at which DMA is requested in DMA mode (TLR RX nibble,
+ * in units of 4).  Anything below it is left for the RX timeout IRQ.
+ */
+#define OMAP_UART_DMA_RX_TLR	(4 << 4)
+
+#define OMAP_UART_IIR_ID	0x3e
+#define OMAP_UART_IIR_RX_TIMEOUT	0x0c
+
 #define OMAP_MAX_HSUART_PORTS	6
 
 #define MSR_SAVE_FLAGS		UART_MSR_ANY_DELTA
@@ -63,6 +75,8 @@ struct omap_uart_port_info {
 	resource_size_t		mapbase;	/* resource base */
 	unsigned long		irqflags;	/* request_irq flags */
 	upf_t			flags;		/* UPF_* flags */
+	unsigned int		dma_rx_buf_size; /* RX DMA ring, 0: default */
+	unsigned int		dma_rx_timeout;	/* RX flush period, usecs */
 };
 
 struct uart_omap_dma {
@@ -74,17 +88,18 @@ struct uart_omap_dma {
 	dma_addr_t		tx_buf_dma_phys;
 	unsigned int		uart_base;
 	/*
-	 * Buffer for rx dma.It is not required for tx because the buffer
-	 * comes from port structure.
+	 * Ring for rx dma, which runs continuously once the port is
+	 * opened.  It is not required for tx because the buffer comes
+	 * from port structure.
 	 */
 	unsigned char		*rx_buf;
-	unsigned int		prev_rx_dma_pos;
+	unsigned int		rx_tail;	/* next offset to push */
 	int			tx_buf_size;
 	int			tx_dma_used;
 	int			rx_dma_used;
 	spinlock_t		tx_lock;
 	spinlock_t		rx_lock;
-	/* timer to poll activity on rx dma */
+	/* timer to flush the rx ring while data is streaming in */
 	struct timer_list	rx_timer;
 	int			rx_buf_size;
 	int			rx_timeout;
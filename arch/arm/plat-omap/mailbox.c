@@ -42,6 +42,17 @@ static unsigned int mbox_kfifo_size = CONFIG_OMAP_MBOX_KFIFO_SIZE;
 module_param(mbox_kfifo_size, uint, S_IRUGO);
 MODULE_PARM_DESC(mbox_kfifo_size, "Size of omap's mailbox kfifo (bytes)");
 
+static unsigned int mbox_rx_poll_threshold = 4;
+module_param(mbox_rx_poll_threshold, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mbox_rx_poll_threshold,
+		"Messages per interrupt to switch rx to polling (0 = never)");
+
+/* max number of messages handed to the bulk notifiers at once */
+#define MBOX_RX_BATCH	16
+
+/* max number of messages delivered per run of the rx work */
+#define MBOX_RX_BUDGET	(8 * MBOX_RX_BATCH)
+
 /* Mailbox FIFO handle functions */
 static inline mbox_msg_t mbox_fifo_read(struct omap_mbox *mbox)
 {
@@ -138,28 +149,110 @@ static void mbox_tx_tasklet(unsigned long tx_data)
 }
 
 /*
- * Message receiver(workqueue)
+ * Move messages from the mailbox fifo to the rx kfifo. Returns the number
+ * of messages read. Called with the rx irq disabled or from the irq handler.
  */
-static void mbox_rx_work(struct work_struct *work)
+static int __mbox_rx_drain(struct omap_mbox *mbox)
 {
-	struct omap_mbox_queue *mq =
-			container_of(work, struct omap_mbox_queue, work);
+	struct omap_mbox_queue *mq = mbox->rxq;
 	mbox_msg_t msg;
-	int len;
+	int len, count = 0;
 
-	while (kfifo_len(&mq->fifo) >= sizeof(msg)) {
-		len = kfifo_out(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
+	while (!mbox_fifo_empty(mbox)) {
+		if (unlikely(kfifo_avail(&mq->fifo) < sizeof(msg))) {
+			mq->full = true;
+			break;
+		}
+
+		msg = mbox_fifo_read(mbox);
+		count++;
+
+		len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
 		WARN_ON(len != sizeof(msg));
 
-		blocking_notifier_call_chain(&mq->mbox->notifier, len,
-								(void *)msg);
-		spin_lock_irq(&mq->lock);
-		if (mq->full) {
-			mq->full = false;
-			omap_mbox_enable_irq(mq->mbox, IRQ_RX);
-		}
-		spin_unlock_irq(&mq->lock);
+		if (mbox->ops->type == OMAP_MBOX_TYPE1)
+			break;
+	}
+
+	return count;
+}
+
+/*
+ * Polling mode: the rx irq stays disabled while messages keep arriving, and
+ * the work handler reads the mailbox fifo itself. Returns true if polling
+ * should go on.
+ */
+static bool mbox_rx_poll(struct omap_mbox_queue *mq)
+{
+	struct omap_mbox *mbox = mq->mbox;
+	bool more = true;
+
+	spin_lock_irq(&mq->lock);
+
+	if (!mq->polling || mq->full) {
+		more = false;
+		goto out;
 	}
+
+	if (__mbox_rx_drain(mbox) || mq->full)
+		goto out;
+
+	/* Ack before the last check, a message arriving after that will
+	 * raise the irq again as soon as it is enabled */
+	ack_mbox_irq(mbox, IRQ_RX);
+	if (!mbox_fifo_empty(mbox))
+		goto out;
+
+	mq->polling = false;
+	omap_mbox_enable_irq(mbox, IRQ_RX);
+	more = false;
+out:
+	spin_unlock_irq(&mq->lock);
+	return more;
+}
+
+/*
+ * Message receiver(workqueue)
+ */
+static void mbox_rx_work(struct work_struct *work)
+{
+	struct omap_mbox_queue *mq =
+			container_of(work, struct omap_mbox_queue, work);
+	mbox_msg_t msgs[MBOX_RX_BATCH];
+	int budget = MBOX_RX_BUDGET;
+	int len, i, n;
+
+	do {
+		while (kfifo_len(&mq->fifo) >= sizeof(mbox_msg_t)) {
+			/* a remote that keeps posting must not hog the
+			 * worker, continue in a new run */
+			if (budget <= 0) {
+				queue_work(mboxd, &mq->work);
+				return;
+			}
+
+			len = kfifo_out(&mq->fifo, (unsigned char *)msgs,
+							sizeof(msgs));
+			WARN_ON(len % sizeof(mbox_msg_t));
+			n = len / sizeof(mbox_msg_t);
+			budget -= n;
+
+			blocking_notifier_call_chain(&mq->mbox->bulk_notifier,
+								n, msgs);
+			for (i = 0; i < n; i++)
+				blocking_notifier_call_chain(
+					&mq->mbox->notifier, sizeof(msgs[i]),
+					(void *)msgs[i]);
+
+			spin_lock_irq(&mq->lock);
+			if (mq->full) {
+				mq->full = false;
+				if (!mq->polling)
+					omap_mbox_enable_irq(mq->mbox, IRQ_RX);
+			}
+			spin_unlock_irq(&mq->lock);
+		}
+	} while (mbox_rx_poll(mq));
 }
 
 /*
@@ -175,28 +268,27 @@ static void __mbox_tx_interrupt(struct omap_mbox *mbox)
 static void __mbox_rx_interrupt(struct omap_mbox *mbox)
 {
 	struct omap_mbox_queue *mq = mbox->rxq;
-	mbox_msg_t msg;
-	int len;
+	int count;
 
-	while (!mbox_fifo_empty(mbox)) {
-		if (unlikely(kfifo_avail(&mq->fifo) < sizeof(msg))) {
-			omap_mbox_disable_irq(mbox, IRQ_RX);
-			mq->full = true;
-			goto nomem;
-		}
+	spin_lock(&mq->lock);
 
-		msg = mbox_fifo_read(mbox);
-
-		len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
-		WARN_ON(len != sizeof(msg));
+	count = __mbox_rx_drain(mbox);
+	if (unlikely(mq->full)) {
+		omap_mbox_disable_irq(mbox, IRQ_RX);
+		goto nomem;
+	}
 
-		if (mbox->ops->type == OMAP_MBOX_TYPE1)
-			break;
+	/* a burst: let the work handler poll until the fifo stays empty */
+	if (mbox_rx_poll_threshold && count >= mbox_rx_poll_threshold &&
+			mbox->ops->type != OMAP_MBOX_TYPE1) {
+		omap_mbox_disable_irq(mbox, IRQ_RX);
+		mq->polling = true;
 	}
 
 	/* no more messages in the fifo. clear IRQ source. */
 	ack_mbox_irq(mbox, IRQ_RX);
 nomem:
+	spin_unlock(&mq->lock);
 	queue_work(mboxd, &mbox->rxq->work);
 }
 
@@ -353,6 +445,33 @@ void omap_mbox_put(struct omap_mbox *mbox, struct notifier_block *nb)
 }
 EXPORT_SYMBOL(omap_mbox_put);
 
+/*
+ * Bulk receivers get all the messages available at once: the notifier is
+ * called with the number of messages and a pointer to an array of them.
+ */
+struct omap_mbox *omap_mbox_get_bulk(const char *name,
+					struct notifier_block *nb)
+{
+	struct omap_mbox *mbox;
+
+	mbox = omap_mbox_get(name, NULL);
+	if (IS_ERR(mbox))
+		return mbox;
+
+	if (nb)
+		blocking_notifier_chain_register(&mbox->bulk_notifier, nb);
+
+	return mbox;
+}
+EXPORT_SYMBOL(omap_mbox_get_bulk);
+
+void omap_mbox_put_bulk(struct omap_mbox *mbox, struct notifier_block *nb)
+{
+	blocking_notifier_chain_unregister(&mbox->bulk_notifier, nb);
+	omap_mbox_fini(mbox);
+}
+EXPORT_SYMBOL(omap_mbox_put_bulk);
+
 static struct class omap_mbox_class = { .name = "mbox", };
 
 int omap_mbox_register(struct device *parent, struct omap_mbox **list)
@@ -374,6 +493,7 @@ int omap_mbox_register(struct device *parent, struct omap_mbox **list)
 		}
 
 		BLOCKING_INIT_NOTIFIER_HEAD(&mbox->notifier);
+		BLOCKING_INIT_NOTIFIER_HEAD(&mbox->bulk_notifier);
 	}
 	return 0;
 
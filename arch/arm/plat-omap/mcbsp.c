@@ -1734,9 +1734,12 @@ static inline void __devinit omap34xx_device_init(struct omap_mcbsp *mcbsp)
 		mcbsp->max_tx_thres = max_thres(mcbsp) - 0x10;
 		mcbsp->max_rx_thres = max_thres(mcbsp) - 0x10;
 		/*
-		 * REVISIT: Set dmap_op_mode to THRESHOLD as default
-		 * for mcbsp2 instances.
+		 * McBSP2 has the big audio buffer: let the sDMA move whole
+		 * periods (or packets of them) instead of one word per DMA
+		 * request.  Still selectable through dma_op_mode.
 		 */
+		if (mcbsp->id == 2)
+			mcbsp->dma_op_mode = MCBSP_DMA_MODE_THRESHOLD;
 		if (omap_additional_add(mcbsp->dev))
 			dev_warn(mcbsp->dev,
 				"Unable to create additional controls\n");
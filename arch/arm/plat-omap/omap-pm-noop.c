@@ -21,6 +21,8 @@
 #include <linux/cpufreq.h>
 #include <linux/device.h>
 #include <linux/platform_device.h>
+#include <linux/pm_qos_params.h>
+#include <linux/slab.h>
 
 /* Interface documentation is in mach/omap-pm.h */
 #include <plat/omap-pm.h>
@@ -29,6 +31,57 @@
 static bool off_mode_enabled;
 static u32 dummy_context_loss_counter;
 
+/*
+ * Wakeup latency constraints are folded into the cpu_dma_latency PM QoS
+ * class, which is what the cpuidle governors honour when picking a
+ * C-state (and with it the MPU/CORE/PER power states).  One request is
+ * kept per (requester, target) pair; t = -1 maps onto
+ * PM_QOS_DEFAULT_VALUE, so it's dropped back to "no constraint" rather
+ * than freed, as drivers tend to toggle these around every transfer.
+ */
+struct omap_pm_lat_req {
+	struct list_head		node;
+	struct device			*req_dev;
+	struct device			*dev;
+	struct pm_qos_request_list	qos;
+};
+
+static LIST_HEAD(omap_pm_lat_reqs);
+static DEFINE_MUTEX(omap_pm_lat_lock);
+
+static int omap_pm_set_lat_req(struct device *req_dev, struct device *dev,
+			       long t)
+{
+	struct omap_pm_lat_req *r;
+	int ret = 0;
+
+	mutex_lock(&omap_pm_lat_lock);
+
+	list_for_each_entry(r, &omap_pm_lat_reqs, node)
+		if (r->req_dev == req_dev && r->dev == dev)
+			goto found;
+
+	if (t == -1)
+		goto out;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	r->req_dev = req_dev;
+	r->dev = dev;
+	pm_qos_add_request(&r->qos, PM_QOS_CPU_DMA_LATENCY, t);
+	list_add(&r->node, &omap_pm_lat_reqs);
+	goto out;
+
+found:
+	pm_qos_update_request(&r->qos, t);
+out:
+	mutex_unlock(&omap_pm_lat_lock);
+	return ret;
+}
+
 /*
  * Device-driver-originated constraints (via board-*.c files)
  */
@@ -57,8 +110,7 @@ int omap_pm_set_max_mpu_wakeup_lat(struct device *dev, long t)
 	 *
 	 * TI CDP code can call constraint_set here.
 	 */
-
-	return 0;
+	return omap_pm_set_lat_req(dev, NULL, t);
 }
 
 int omap_pm_set_min_bus_tput(struct device *dev, u8 agent_id, unsigned long r)
@@ -115,9 +167,11 @@ int omap_pm_set_max_dev_wakeup_lat(struct device *req_dev, struct device *dev,
 	 * depending on how long it takes to re-enable the clocks.
 	 *
 	 * TI CDP code can call constraint_set here.
+	 *
+	 * Until then, constrain the C-state, which bounds how deep
+	 * the device's powerdomain can go along with MPU and CORE.
 	 */
-
-	return 0;
+	return omap_pm_set_lat_req(req_dev, dev, t);
 }
 
 int omap_pm_set_max_sdma_lat(struct device *dev, long t)
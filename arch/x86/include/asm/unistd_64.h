@@ -669,6 +669,13 @@ __SYSCALL(__NR_fanotify_init, sys_fanotify_init)
 __SYSCALL(__NR_fanotify_mark, sys_fanotify_mark)
 #define __NR_prlimit64				302
 __SYSCALL(__NR_prlimit64, sys_prlimit64)
+/* 303 - 306 reserved */
+__SYSCALL(303, sys_ni_syscall)
+__SYSCALL(304, sys_ni_syscall)
+__SYSCALL(305, sys_ni_syscall)
+__SYSCALL(306, sys_ni_syscall)
+#define __NR_sendmmsg				307
+__SYSCALL(__NR_sendmmsg, sys_sendmmsg)
 
 #ifndef __NO_STUBS
 #define __ARCH_WANT_OLD_READDIR
@@ -0,0 +1,528 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  A deadline derivative for SD/eMMC media: reads are cheap and are
+ *  served first, writes are expensive when they straddle allocation
+ *  units, so they are dispatched one unit at a time.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int read_expire = HZ / 10;	/* max time before a read is submitted. */
+static const int write_expire = 5 * HZ;	/* ditto for writes, these limits are SOFT! */
+static const int writes_starved = 16;	/* max reads dispatched while writes wait */
+
+/* unit used when neither the user nor the driver has set one */
+#define FLASH_DEFAULT_UNIT	((4 * 1024 * 1024) >> 9)
+
+struct flash_data {
+	struct request_queue *queue;
+
+	/*
+	 * requests are present on both sort_list and fifo_list
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	/*
+	 * next in sort order. read, write or both are NULL
+	 */
+	struct request *next_rq[2];
+	unsigned int starved;		/* reads dispatched while writes wait */
+	sector_t write_unit;		/* unit the current write batch fills */
+	int write_unit_valid;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int writes_starved;
+	int front_merges;
+	unsigned int unit_sectors;	/* 0: take queue's optimal_io_size */
+};
+
+static void flash_move_request(struct flash_data *, struct request *);
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static unsigned int flash_unit_sectors(struct flash_data *fd)
+{
+	unsigned int opt;
+
+	if (fd->unit_sectors)
+		return fd->unit_sectors;
+
+	opt = queue_io_opt(fd->queue) >> 9;
+	return opt ? opt : FLASH_DEFAULT_UNIT;
+}
+
+static inline sector_t flash_unit_of(struct request *rq, unsigned int unit)
+{
+	sector_t pos = blk_rq_pos(rq);
+
+	sector_div(pos, unit);
+	return pos;
+}
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_request(fd, __alias);
+}
+
+static inline void
+flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+
+	if (fd->next_rq[data_dir] == rq)
+		fd->next_rq[data_dir] = flash_latter_request(rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[data_dir]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[data_dir]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move an entry to dispatch queue
+ */
+static void
+flash_move_request(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	const int data_dir = rq_data_dir(rq);
+
+	fd->next_rq[data_dir] = flash_latter_request(rq);
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * flash_check_fifo returns 0 if there are no expired requests on the fifo,
+ * 1 otherwise. Requires !list_empty(&fd->fifo_list[data_dir])
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int ddir)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[ddir].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Return the lowest-sectored queued write in the same unit as @rq.
+ */
+static struct request *
+flash_unit_first(struct request *rq, unsigned int unit)
+{
+	sector_t this_unit = flash_unit_of(rq, unit);
+	struct rb_node *node;
+
+	while ((node = rb_prev(&rq->rb_node)) != NULL) {
+		struct request *prev = rb_entry_rq(node);
+
+		if (flash_unit_of(prev, unit) != this_unit)
+			break;
+		rq = prev;
+	}
+
+	return rq;
+}
+
+/*
+ * Find the unit holding the most queued write sectors and return its
+ * first request.  The sort list holds at most nr_requests entries, and
+ * this only runs when a new write batch starts.
+ */
+static struct request *
+flash_densest_unit(struct flash_data *fd, unsigned int unit)
+{
+	struct request *best_rq = NULL, *cur_rq = NULL;
+	unsigned long best = 0, cur = 0;
+	sector_t cur_unit = 0;
+	struct rb_node *node;
+
+	for (node = rb_first(&fd->sort_list[WRITE]); node;
+	     node = rb_next(node)) {
+		struct request *rq = rb_entry_rq(node);
+		sector_t u = flash_unit_of(rq, unit);
+
+		if (!cur_rq || u != cur_unit) {
+			cur_unit = u;
+			cur_rq = rq;
+			cur = 0;
+		}
+
+		cur += blk_rq_sectors(rq);
+		if (cur > best) {
+			best = cur;
+			best_rq = cur_rq;
+		}
+	}
+
+	return best_rq;
+}
+
+/*
+ * Pick the next write: keep filling the unit the current batch is in,
+ * in sector order; otherwise start on the unit with the most data
+ * queued, or the unit of the oldest write once that one has expired.
+ */
+static struct request *flash_next_write(struct flash_data *fd)
+{
+	unsigned int unit = flash_unit_sectors(fd);
+	struct request *rq = fd->next_rq[WRITE];
+	int expired = flash_check_fifo(fd, WRITE);
+
+	if (rq && !expired && fd->write_unit_valid &&
+	    flash_unit_of(rq, unit) == fd->write_unit)
+		return rq;
+
+	if (expired)
+		rq = flash_unit_first(rq_entry_fifo(fd->fifo_list[WRITE].next),
+				      unit);
+	else
+		rq = flash_densest_unit(fd, unit);
+
+	fd->write_unit = flash_unit_of(rq, unit);
+	fd->write_unit_valid = 1;
+	return rq;
+}
+
+/*
+ * Reads go first, oldest first once one has expired and in sector order
+ * otherwise.  Writes get the device when no read is waiting, when their
+ * own fifo has expired, or once writes_starved reads went by them.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = !list_empty(&fd->fifo_list[READ]);
+	const int writes = !list_empty(&fd->fifo_list[WRITE]);
+	struct request *rq;
+
+	if (reads) {
+		BUG_ON(RB_EMPTY_ROOT(&fd->sort_list[READ]));
+
+		if (writes && (fd->starved >= fd->writes_starved ||
+			       flash_check_fifo(fd, WRITE)))
+			goto dispatch_writes;
+
+		if (writes)
+			fd->starved++;
+
+		if (flash_check_fifo(fd, READ) || !fd->next_rq[READ])
+			rq = rq_entry_fifo(fd->fifo_list[READ].next);
+		else
+			rq = fd->next_rq[READ];
+
+		flash_move_request(fd, rq);
+		return 1;
+	}
+
+	if (writes) {
+dispatch_writes:
+		BUG_ON(RB_EMPTY_ROOT(&fd->sort_list[WRITE]));
+
+		fd->starved = 0;
+		flash_move_request(fd, flash_next_write(fd));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[WRITE])
+		&& list_empty(&fd->fifo_list[READ]);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[READ]));
+	BUG_ON(!list_empty(&fd->fifo_list[WRITE]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	fd->queue = q;
+	INIT_LIST_HEAD(&fd->fifo_list[READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[WRITE]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->fifo_expire[READ] = read_expire;
+	fd->fifo_expire[WRITE] = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_read_expire_show, fd->fifo_expire[READ], 1);
+SHOW_FUNCTION(flash_write_expire_show, fd->fifo_expire[WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_read_expire_store, &fd->fifo_expire[READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_write_expire_store, &fd->fifo_expire[WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+/*
+ * unit_size is in KiB; it reads back the size in effect, and writing 0
+ * goes back to following the queue's optimal_io_size.
+ */
+static ssize_t flash_unit_size_show(struct elevator_queue *e, char *page)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	return flash_var_show(flash_unit_sectors(fd) >> 1, page);
+}
+
+static ssize_t
+flash_unit_size_store(struct elevator_queue *e, const char *page, size_t count)
+{
+	struct flash_data *fd = e->elevator_data;
+	int __data;
+	int ret = flash_var_store(&__data, page, count);
+
+	if (__data < 0)
+		__data = 0;
+	else if (__data > INT_MAX >> 1)
+		__data = INT_MAX >> 1;
+	fd->unit_sectors = __data << 1;
+	fd->write_unit_valid = 0;
+	return ret;
+}
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(read_expire),
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(front_merges),
+	FD_ATTR(unit_size),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
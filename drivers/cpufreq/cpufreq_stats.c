@@ -20,10 +20,14 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/hrtimer.h>
 #include <asm/cputime.h>
 
 static spinlock_t cpufreq_stats_lock;
 
+/* log2 usec buckets for transition latency; the last one is open ended */
+#define CPUFREQ_STATS_LAT_BUCKETS	16
+
 #define CPUFREQ_STATDEVICE_ATTR(_name, _mode, _show) \
 static struct freq_attr _attr_##_name = {\
 	.attr = {.name = __stringify(_name), .mode = _mode, }, \
@@ -42,6 +46,9 @@ struct cpufreq_stats {
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	unsigned int *trans_table;
 #endif
+	ktime_t trans_start;
+	unsigned int trans_lat_max;
+	unsigned int trans_lat[CPUFREQ_STATS_LAT_BUCKETS];
 };
 
 static DEFINE_PER_CPU(struct cpufreq_stats *, cpufreq_stats_table);
@@ -140,12 +147,42 @@ static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 CPUFREQ_STATDEVICE_ATTR(trans_table, 0444, show_trans_table);
 #endif
 
+/*
+ * Time from PRECHANGE to POSTCHANGE, i.e. how long the driver took to
+ * switch frequency (including any voltage scaling it did meanwhile).
+ */
+static ssize_t show_trans_latency(struct cpufreq_policy *policy, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, policy->cpu);
+	if (!stat)
+		return 0;
+	len += sprintf(buf + len, "   usecs : count\n");
+	spin_lock(&cpufreq_stats_lock);
+	for (i = 0; i < CPUFREQ_STATS_LAT_BUCKETS; i++) {
+		if (!stat->trans_lat[i])
+			continue;
+		if (i == CPUFREQ_STATS_LAT_BUCKETS - 1)
+			len += sprintf(buf + len, "%8u+: %u\n",
+				       1 << (i - 1), stat->trans_lat[i]);
+		else
+			len += sprintf(buf + len, "%8u : %u\n",
+				       (1 << i) - 1, stat->trans_lat[i]);
+	}
+	len += sprintf(buf + len, "max %u\n", stat->trans_lat_max);
+	spin_unlock(&cpufreq_stats_lock);
+	return len;
+}
+
 CPUFREQ_STATDEVICE_ATTR(total_trans, 0444, show_total_trans);
 CPUFREQ_STATDEVICE_ATTR(time_in_state, 0444, show_time_in_state);
+CPUFREQ_STATDEVICE_ATTR(trans_latency, 0444, show_trans_latency);
 
 static struct attribute *default_attrs[] = {
 	&_attr_total_trans.attr,
 	&_attr_time_in_state.attr,
+	&_attr_trans_latency.attr,
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	&_attr_trans_table.attr,
 #endif
@@ -277,14 +314,32 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	struct cpufreq_freqs *freq = data;
 	struct cpufreq_stats *stat;
 	int old_index, new_index;
+	unsigned int lat;
 
-	if (val != CPUFREQ_POSTCHANGE)
+	if (val != CPUFREQ_PRECHANGE && val != CPUFREQ_POSTCHANGE)
 		return 0;
 
 	stat = per_cpu(cpufreq_stats_table, freq->cpu);
 	if (!stat)
 		return 0;
 
+	if (val == CPUFREQ_PRECHANGE) {
+		stat->trans_start = ktime_get();
+		return 0;
+	}
+
+	if (stat->trans_start.tv64) {
+		lat = ktime_us_delta(ktime_get(), stat->trans_start);
+		stat->trans_start.tv64 = 0;
+
+		spin_lock(&cpufreq_stats_lock);
+		stat->trans_lat[min(fls(lat),
+				    CPUFREQ_STATS_LAT_BUCKETS - 1)]++;
+		if (lat > stat->trans_lat_max)
+			stat->trans_lat_max = lat;
+		spin_unlock(&cpufreq_stats_lock);
+	}
+
 	old_index = stat->last_index;
 	new_index = freq_table_get_index(stat, freq->new);
 
@@ -40,6 +40,12 @@
 #include <linux/slab.h>
 #include <linux/i2c-omap.h>
 #include <linux/pm_runtime.h>
+#include <linux/dma-mapping.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+
+#include <plat/dma.h>
 
 /* I2C controller revisions */
 #define OMAP_I2C_REV_2			0x20
@@ -52,6 +58,14 @@
 /* timeout waiting for the controller to respond */
 #define OMAP_I2C_TIMEOUT (msecs_to_jiffies(1000))
 
+/* Largest message moved by sDMA, through a coherent bounce buffer */
+#define OMAP_I2C_DMA_BUF_SIZE	PAGE_SIZE
+
+static unsigned int dma_threshold = 64;
+module_param(dma_threshold, uint, 0644);
+MODULE_PARM_DESC(dma_threshold,
+		 "Use sDMA for messages of at least this many bytes (0 = never)");
+
 /* For OMAP3 I2C_IV has changed to I2C_WE (wakeup enable) */
 enum {
 	OMAP_I2C_REV_REG = 0,
@@ -172,9 +186,22 @@ enum {
 #define I2C_OMAP_ERRATA_I207		(1 << 0)
 #define I2C_OMAP3_1P153			(1 << 1)
 
+struct omap_i2c_stats {
+	unsigned long		xfers;		/* i2c_transfer() calls */
+	unsigned long		msgs;		/* messages completed */
+	unsigned long		dma_msgs;	/* ... of which done by sDMA */
+	unsigned long		errors;
+	unsigned long		timeouts;
+	u64			bytes;
+	u64			total_us;	/* summed i2c_transfer() latency */
+	u32			min_us;
+	u32			max_us;
+};
+
 struct omap_i2c_dev {
 	struct device		*dev;
 	void __iomem		*base;		/* virtual */
+	u32			phys_base;	/* physical */
 	int			irq;
 	int			reg_shift;      /* bit shift for I2C register addresses */
 	struct completion	cmd_complete;
@@ -203,6 +230,19 @@ struct omap_i2c_dev {
 	u16			syscstate;
 	u16			westate;
 	u16			errata;
+
+	int			dma_rx_req;
+	int			dma_tx_req;
+	int			dma_rx_ch;	/* -1 if RX DMA unavailable */
+	int			dma_tx_ch;	/* -1 if TX DMA unavailable */
+	void			*dma_buf;
+	dma_addr_t		dma_buf_phys;
+	struct completion	dma_complete;
+
+	struct omap_i2c_stats	stats;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry		*debugfs;
+#endif
 };
 
 const static u8 reg_map[] = {
@@ -496,11 +536,12 @@ static int omap_i2c_init(struct omap_i2c_dev *dev)
 			OMAP_I2C_IE_AL)  | ((dev->fifo_size) ?
 				(OMAP_I2C_IE_RDR | OMAP_I2C_IE_XDR) : 0);
 	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate);
+	/* Also used to restore the FIFO thresholds after a DMA message */
+	dev->bufstate = buf;
 	if (cpu_is_omap34xx()) {
 		dev->pscstate = psc;
 		dev->scllstate = scll;
 		dev->sclhstate = sclh;
-		dev->bufstate = buf;
 	}
 	return 0;
 }
@@ -524,6 +565,81 @@ static int omap_i2c_wait_for_bb(struct omap_i2c_dev *dev)
 	return 0;
 }
 
+static void omap_i2c_dma_callback(int lch, u16 ch_status, void *data)
+{
+	struct omap_i2c_dev *dev = data;
+
+	complete(&dev->dma_complete);
+}
+
+static int omap_i2c_use_dma(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	if (!dma_threshold || msg->len < dma_threshold ||
+	    msg->len > OMAP_I2C_DMA_BUF_SIZE)
+		return 0;
+
+	if (msg->flags & I2C_M_RD)
+		return dev->dma_rx_ch >= 0;
+
+	return dev->dma_tx_ch >= 0;
+}
+
+/*
+ * Hand the FIFO over to sDMA for this message. The thresholds are
+ * dropped to a single byte so the request line stays asserted down to
+ * the last byte of the message, and the data interrupts are masked:
+ * the CPU is only woken for ARDY (or an error) and the DMA callback.
+ */
+static void omap_i2c_dma_start(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	u32 data_reg = dev->phys_base +
+		(dev->regs[OMAP_I2C_DATA_REG] << dev->reg_shift);
+	u16 buf = OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
+	int ch;
+
+	if (msg->flags & I2C_M_RD) {
+		ch = dev->dma_rx_ch;
+		omap_set_dma_transfer_params(ch, OMAP_DMA_DATA_TYPE_S8,
+				msg->len, 1, OMAP_DMA_SYNC_ELEMENT,
+				dev->dma_rx_req, 1);
+		omap_set_dma_src_params(ch, 0, OMAP_DMA_AMODE_CONSTANT,
+				data_reg, 0, 0);
+		omap_set_dma_dest_params(ch, 0, OMAP_DMA_AMODE_POST_INC,
+				dev->dma_buf_phys, 0, 0);
+		buf |= OMAP_I2C_BUF_RDMA_EN;
+	} else {
+		memcpy(dev->dma_buf, msg->buf, msg->len);
+		ch = dev->dma_tx_ch;
+		omap_set_dma_transfer_params(ch, OMAP_DMA_DATA_TYPE_S8,
+				msg->len, 1, OMAP_DMA_SYNC_ELEMENT,
+				dev->dma_tx_req, 0);
+		omap_set_dma_dest_params(ch, 0, OMAP_DMA_AMODE_CONSTANT,
+				data_reg, 0, 0);
+		omap_set_dma_src_params(ch, 0, OMAP_DMA_AMODE_POST_INC,
+				dev->dma_buf_phys, 0, 0);
+		buf |= OMAP_I2C_BUF_XDMA_EN;
+	}
+
+	INIT_COMPLETION(dev->dma_complete);
+	omap_start_dma(ch);
+
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, buf);
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate &
+			~(OMAP_I2C_IE_XRDY | OMAP_I2C_IE_RRDY |
+			  OMAP_I2C_IE_XDR | OMAP_I2C_IE_RDR));
+}
+
+static void omap_i2c_dma_stop(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	if (msg->flags & I2C_M_RD)
+		omap_stop_dma(dev->dma_rx_ch);
+	else
+		omap_stop_dma(dev->dma_tx_ch);
+
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, dev->bufstate);
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate);
+}
+
 /*
  * Low level master read/write transaction.
  */
@@ -531,6 +647,7 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 			     struct i2c_msg *msg, int stop)
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
+	int dma;
 	int r;
 	u16 w;
 
@@ -548,14 +665,21 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 
 	omap_i2c_write_reg(dev, OMAP_I2C_CNT_REG, dev->buf_len);
 
-	/* Clear the FIFO Buffers */
-	w = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
-	w |= OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
-	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
-
-	init_completion(&dev->cmd_complete);
+	INIT_COMPLETION(dev->cmd_complete);
 	dev->cmd_err = 0;
 
+	dma = omap_i2c_use_dma(dev, msg);
+	if (dma) {
+		/* The ISR must not touch the FIFO behind the DMA engine */
+		dev->buf_len = 0;
+		omap_i2c_dma_start(dev, msg);
+	} else {
+		/* Clear the FIFO Buffers */
+		w = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
+		w |= OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
+		omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
+	}
+
 	w = OMAP_I2C_CON_EN | OMAP_I2C_CON_MST | OMAP_I2C_CON_STT;
 
 	/* High speed configuration */
@@ -585,6 +709,8 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 			if (time_after(jiffies, delay)) {
 				dev_err(dev->dev, "controller timed out "
 				"waiting for start condition to finish\n");
+				if (dma)
+					omap_i2c_dma_stop(dev, msg);
 				return -ETIMEDOUT;
 			}
 			cpu_relax();
@@ -599,13 +725,27 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	 * REVISIT: We should abort the transfer on signals, but the bus goes
 	 * into arbitration and we're currently unable to recover from it.
 	 */
-	if (dev->set_mpu_wkup_lat != NULL)
-		dev->set_mpu_wkup_lat(dev->dev, dev->latency);
 	r = wait_for_completion_timeout(&dev->cmd_complete,
 					OMAP_I2C_TIMEOUT);
-	if (dev->set_mpu_wkup_lat != NULL)
-		dev->set_mpu_wkup_lat(dev->dev, -1);
 	dev->buf_len = 0;
+
+	if (dma) {
+		/*
+		 * ARDY can beat the last RX bytes out of the FIFO; the
+		 * message is only done once the channel has drained it.
+		 */
+		if (r > 0 && !dev->cmd_err &&
+		    !wait_for_completion_timeout(&dev->dma_complete,
+						 OMAP_I2C_TIMEOUT))
+			r = 0;
+		omap_i2c_dma_stop(dev, msg);
+		if (r > 0 && !dev->cmd_err) {
+			if (msg->flags & I2C_M_RD)
+				memcpy(msg->buf, dev->dma_buf, msg->len);
+			dev->stats.dma_msgs++;
+		}
+	}
+
 	if (r < 0)
 		return r;
 	if (r == 0) {
@@ -638,6 +778,30 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 }
 
 
+static void omap_i2c_account(struct omap_i2c_dev *dev, ktime_t start,
+			     struct i2c_msg msgs[], int done, int r)
+{
+	struct omap_i2c_stats *s = &dev->stats;
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	int i;
+
+	for (i = 0; i < done; i++)
+		s->bytes += msgs[i].len;
+	s->msgs += done;
+
+	if (r == -ETIMEDOUT)
+		s->timeouts++;
+	else if (r < 0)
+		s->errors++;
+
+	if (!s->xfers || us < s->min_us)
+		s->min_us = us;
+	if (us > s->max_us)
+		s->max_us = us;
+	s->total_us += us;
+	s->xfers++;
+}
+
 /*
  * Prepare controller for a transaction and call omap_i2c_xfer_msg
  * to do the work during IRQ processing.
@@ -646,7 +810,8 @@ static int
 omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
-	int i;
+	ktime_t start = ktime_get();
+	int i = 0;
 	int r;
 
 	omap_i2c_unidle(dev);
@@ -655,18 +820,30 @@ omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	if (r < 0)
 		goto out;
 
+	/*
+	 * The segments of a combined message are issued back to back with
+	 * repeated starts, so keep the MPU wakeup constraint up for the
+	 * whole transfer rather than re-arming it around every segment.
+	 */
+	if (dev->set_mpu_wkup_lat != NULL)
+		dev->set_mpu_wkup_lat(dev->dev, dev->latency);
+
 	for (i = 0; i < num; i++) {
 		r = omap_i2c_xfer_msg(adap, &msgs[i], (i == (num - 1)));
 		if (r != 0)
 			break;
 	}
 
+	if (dev->set_mpu_wkup_lat != NULL)
+		dev->set_mpu_wkup_lat(dev->dev, -1);
+
 	if (r == 0)
 		r = num;
 
 	omap_i2c_wait_for_bb(dev);
 out:
 	omap_i2c_idle(dev);
+	omap_i2c_account(dev, start, msgs, i, r);
 	return r;
 }
 
@@ -968,6 +1145,125 @@ static const struct i2c_algorithm omap_i2c_algo = {
 	.functionality	= omap_i2c_func,
 };
 
+/*
+ * Only controllers with a FIFO can drive the DMA request lines. TX is
+ * left to the CPU on parts hit by errata 1.153, which needs every
+ * write to DATA_REG paced against XUDF.
+ */
+static void __devinit
+omap_i2c_request_dma(struct omap_i2c_dev *dev, struct platform_device *pdev)
+{
+	struct resource *res;
+
+	dev->dma_rx_ch = -1;
+	dev->dma_tx_ch = -1;
+
+	if (!dev->fifo_size)
+		return;
+
+	init_completion(&dev->dma_complete);
+	dev->dma_buf = dma_alloc_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+					  &dev->dma_buf_phys, GFP_KERNEL);
+	if (!dev->dma_buf)
+		return;
+
+	res = platform_get_resource_byname(pdev, IORESOURCE_DMA, "rx");
+	if (res) {
+		dev->dma_rx_req = res->start;
+		if (omap_request_dma(dev->dma_rx_req, "I2C RX",
+				     omap_i2c_dma_callback, dev,
+				     &dev->dma_rx_ch)) {
+			dev_warn(dev->dev, "no RX DMA channel\n");
+			dev->dma_rx_ch = -1;
+		}
+	}
+
+	res = platform_get_resource_byname(pdev, IORESOURCE_DMA, "tx");
+	if (res && dev->rev > OMAP_I2C_REV_ON_3430) {
+		dev->dma_tx_req = res->start;
+		if (omap_request_dma(dev->dma_tx_req, "I2C TX",
+				     omap_i2c_dma_callback, dev,
+				     &dev->dma_tx_ch)) {
+			dev_warn(dev->dev, "no TX DMA channel\n");
+			dev->dma_tx_ch = -1;
+		}
+	}
+
+	if (dev->dma_rx_ch < 0 && dev->dma_tx_ch < 0) {
+		dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+				  dev->dma_buf, dev->dma_buf_phys);
+		dev->dma_buf = NULL;
+	}
+}
+
+static void omap_i2c_free_dma(struct omap_i2c_dev *dev)
+{
+	if (dev->dma_rx_ch >= 0)
+		omap_free_dma(dev->dma_rx_ch);
+	if (dev->dma_tx_ch >= 0)
+		omap_free_dma(dev->dma_tx_ch);
+	if (dev->dma_buf)
+		dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+				  dev->dma_buf, dev->dma_buf_phys);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int omap_i2c_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap_i2c_dev *dev = s->private;
+	struct omap_i2c_stats *st = &dev->stats;
+	u64 avg = st->total_us;
+
+	if (st->xfers)
+		do_div(avg, st->xfers);
+
+	seq_printf(s, "transfers:   %lu\n", st->xfers);
+	seq_printf(s, "messages:    %lu (%lu dma)\n", st->msgs, st->dma_msgs);
+	seq_printf(s, "bytes:       %llu\n", st->bytes);
+	seq_printf(s, "errors:      %lu\n", st->errors);
+	seq_printf(s, "timeouts:    %lu\n", st->timeouts);
+	seq_printf(s, "latency us:  min %u avg %llu max %u\n",
+		   st->min_us, avg, st->max_us);
+	seq_printf(s, "dma:         rx %s tx %s threshold %u\n",
+		   dev->dma_rx_ch >= 0 ? "on" : "off",
+		   dev->dma_tx_ch >= 0 ? "on" : "off", dma_threshold);
+
+	return 0;
+}
+
+static int omap_i2c_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_i2c_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap_i2c_stats_fops = {
+	.open		= omap_i2c_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void omap_i2c_debugfs_init(struct omap_i2c_dev *dev)
+{
+	dev->debugfs = debugfs_create_dir(dev_name(dev->dev), NULL);
+	if (IS_ERR_OR_NULL(dev->debugfs)) {
+		dev->debugfs = NULL;
+		return;
+	}
+
+	debugfs_create_file("stats", S_IRUGO, dev->debugfs, dev,
+			    &omap_i2c_stats_fops);
+}
+
+static void omap_i2c_debugfs_exit(struct omap_i2c_dev *dev)
+{
+	debugfs_remove_recursive(dev->debugfs);
+}
+#else
+static inline void omap_i2c_debugfs_init(struct omap_i2c_dev *dev) { }
+static inline void omap_i2c_debugfs_exit(struct omap_i2c_dev *dev) { }
+#endif
+
 static int __devinit
 omap_i2c_probe(struct platform_device *pdev)
 {
@@ -1016,6 +1312,8 @@ omap_i2c_probe(struct platform_device *pdev)
 	dev->idle = 1;
 	dev->dev = &pdev->dev;
 	dev->irq = irq->start;
+	dev->phys_base = mem->start;
+	init_completion(&dev->cmd_complete);
 	dev->base = ioremap(mem->start, resource_size(mem));
 	if (!dev->base) {
 		r = -ENOMEM;
@@ -1083,12 +1381,14 @@ omap_i2c_probe(struct platform_device *pdev)
 	/* reset ASAP, clearing any IRQs */
 	omap_i2c_init(dev);
 
+	omap_i2c_request_dma(dev, pdev);
+
 	isr = (dev->rev < OMAP_I2C_REV_2) ? omap_i2c_rev1_isr : omap_i2c_isr;
 	r = request_irq(dev->irq, isr, 0, pdev->name, dev);
 
 	if (r) {
 		dev_err(dev->dev, "failure requesting irq %i\n", dev->irq);
-		goto err_unuse_clocks;
+		goto err_free_dma;
 	}
 
 	dev_info(dev->dev, "bus %d rev%d.%d at %d kHz\n",
@@ -1112,11 +1412,14 @@ omap_i2c_probe(struct platform_device *pdev)
 		goto err_free_irq;
 	}
 
+	omap_i2c_debugfs_init(dev);
+
 	return 0;
 
 err_free_irq:
 	free_irq(dev->irq, dev);
-err_unuse_clocks:
+err_free_dma:
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	omap_i2c_idle(dev);
 	iounmap(dev->base);
@@ -1137,8 +1440,10 @@ omap_i2c_remove(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, NULL);
 
+	omap_i2c_debugfs_exit(dev);
 	free_irq(dev->irq, dev);
 	i2c_del_adapter(&dev->adapter);
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	iounmap(dev->base);
 	kfree(dev);
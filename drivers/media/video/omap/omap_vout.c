@@ -98,6 +98,7 @@ static u32 video1_bufsize = OMAP_VOUT_MAX_BUF_SIZE;
 static u32 video2_bufsize = OMAP_VOUT_MAX_BUF_SIZE;
 static u32 vid1_static_vrfb_alloc;
 static u32 vid2_static_vrfb_alloc;
+static u32 vrfb_direct;
 static int debug;
 
 /* Module parameters */
@@ -125,6 +126,10 @@ module_param(vid2_static_vrfb_alloc, bool, S_IRUGO);
 MODULE_PARM_DESC(vid2_static_vrfb_alloc,
 	"Static allocation of the VRFB buffer for video2 device");
 
+module_param(vrfb_direct, bool, S_IRUGO);
+MODULE_PARM_DESC(vrfb_direct,
+	"Map the VRFB space directly to MMAP buffers when rotation is enabled");
+
 module_param(debug, bool, S_IRUGO);
 MODULE_PARM_DESC(debug, "Debug level (0-1)");
 
@@ -385,6 +390,26 @@ static inline int rotation_enabled(const struct omap_vout_device *vout)
 	return vout->rotation || vout->mirror;
 }
 
+/*
+ * Return true if MMAP buffers can be the VRFB 0 degree views themselves.
+ * The application then renders with the VRFB line length, and DSS reads the
+ * rotated view without a per frame sDMA copy.
+ */
+static inline int vrfb_direct_possible(const struct omap_vout_device *vout)
+{
+	return vrfb_direct && rotation_enabled(vout) &&
+		V4L2_MEMORY_MMAP == vout->memory;
+}
+
+/*
+ * Size of the VRFB 0 degree view of a buffer, as seen by the application
+ */
+static inline u32 vrfb_direct_size(const struct omap_vout_device *vout)
+{
+	return PAGE_ALIGN(MAX_PIXELS_PER_LINE * vout->bpp * vout->vrfb_bpp *
+			vout->pix.height);
+}
+
 /*
  * Reverse the rotation degree if mirroring is enabled
  */
@@ -974,6 +999,16 @@ static int omap_vout_buffer_setup(struct videobuf_queue *q, unsigned int *count,
 		if (omap_vout_vrfb_buffer_setup(vout, count, startindex))
 			return -ENOMEM;
 
+	vout->vrfb_direct = vrfb_direct_possible(vout);
+	if (vout->vrfb_direct) {
+		/* The VRFB buffers are the V4L2 buffers */
+		vout->pix.bytesperline = MAX_PIXELS_PER_LINE * vout->bpp *
+			vout->vrfb_bpp;
+		*size = vrfb_direct_size(vout);
+		return 0;
+	}
+	vout->pix.bytesperline = vout->pix.width * vout->bpp;
+
 	if (V4L2_MEMORY_MMAP != vout->memory)
 		return 0;
 
@@ -1093,6 +1128,15 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 	if (!rotation_enabled(vout))
 		return 0;
 
+	rotation = calc_rotation(vout);
+
+	/* The application rendered straight into the VRFB space */
+	if (vout->vrfb_direct && V4L2_MEMORY_MMAP == vb->memory) {
+		vout->queued_buf_addr[vb->i] = (u8 *)
+			vout->vrfb_context[vb->i].paddr[rotation];
+		return 0;
+	}
+
 	dmabuf = vout->buf_phy_addr[vb->i];
 	/* If rotation is enabled, copy input buffer into VRFB
 	 * memory space using DMA. We are copying input buffer
@@ -1125,7 +1169,6 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 			dmabuf, src_element_index, src_frame_index);
 	/*set dma source burst mode for VRFB */
 	omap_set_dma_src_burst_mode(tx->dma_ch, OMAP_DMA_DATA_BURST_16);
-	rotation = calc_rotation(vout);
 
 	/* dest_port required only for OMAP1 */
 	omap_set_dma_dest_params(tx->dma_ch, 0, OMAP_DMA_AMODE_DOUBLE_IDX,
@@ -1207,6 +1250,40 @@ static struct vm_operations_struct omap_vout_vm_ops = {
 	.close	= omap_vout_vm_close,
 };
 
+/*
+ * Map the VRFB 0 degree view of buffer i. The view is not RAM but the VRFB
+ * address space, which rotates the data into the SMS shadow buffer.
+ */
+static int omap_vout_mmap_vrfb(struct omap_vout_device *vout,
+		struct vm_area_struct *vma, int i)
+{
+	unsigned long size = (vma->vm_end - vma->vm_start);
+	struct videobuf_queue *q = &vout->vbq;
+
+	if (size > vrfb_direct_size(vout)) {
+		v4l2_err(&vout->vid_dev->v4l2_dev,
+				"insufficient VRFB space [%lu] [%u]\n",
+				size, vrfb_direct_size(vout));
+		return -ENOMEM;
+	}
+
+	q->bufs[i]->baddr = vma->vm_start;
+
+	vma->vm_flags |= VM_IO | VM_RESERVED;
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	vma->vm_ops = &omap_vout_vm_ops;
+	vma->vm_private_data = (void *) vout;
+	vma->vm_pgoff = vout->vrfb_context[i].paddr[0] >> PAGE_SHIFT;
+
+	if (io_remap_pfn_range(vma, vma->vm_start, vma->vm_pgoff, size,
+				vma->vm_page_prot))
+		return -EAGAIN;
+
+	vout->mmap_count++;
+
+	return 0;
+}
+
 static int omap_vout_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	int i;
@@ -1236,6 +1313,9 @@ static int omap_vout_mmap(struct file *file, struct vm_area_struct *vma)
 				(vma->vm_pgoff << PAGE_SHIFT));
 		return -EINVAL;
 	}
+	if (vout->vrfb_direct)
+		return omap_vout_mmap_vrfb(vout, vma, i);
+
 	/* Check the size of the buffer */
 	if (size > vout->buffer_size) {
 		v4l2_err(&vout->vid_dev->v4l2_dev,
@@ -1832,8 +1912,9 @@ static int vidioc_reqbufs(struct file *file, void *fh,
 		num_buffers = (vout->vid == OMAP_VIDEO1) ?
 			video1_numbuffers : video2_numbuffers;
 		for (i = num_buffers; i < vout->buffer_allocated; i++) {
-			omap_vout_free_buffer(vout->buf_virt_addr[i],
-					vout->buffer_size);
+			if (vout->buf_virt_addr[i])
+				omap_vout_free_buffer(vout->buf_virt_addr[i],
+						vout->buffer_size);
 			vout->buf_virt_addr[i] = 0;
 			vout->buf_phy_addr[i] = 0;
 		}
@@ -1893,7 +1974,7 @@ static int vidioc_qbuf(struct file *file, void *fh,
 		}
 	}
 
-	if ((rotation_enabled(vout)) &&
+	if ((rotation_enabled(vout)) && !vout->vrfb_direct &&
 			vout->vrfb_dma_tx.req_status == DMA_CHAN_NOT_ALLOTED) {
 		v4l2_warn(&vout->vid_dev->v4l2_dev,
 				"DMA Channel not allocated for Rotation\n");
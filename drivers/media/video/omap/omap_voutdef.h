@@ -125,6 +125,8 @@ struct omap_vout_device {
 	unsigned int smsshado_virt_addr[MAC_VRFB_CTXS];
 	struct vrfb vrfb_context[MAC_VRFB_CTXS];
 	bool vrfb_static_allocation;
+	/* MMAP buffers are the VRFB 0 degree views, no sDMA copy needed */
+	bool vrfb_direct;
 	unsigned int smsshado_size;
 	unsigned char pos;
 
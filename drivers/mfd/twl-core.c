@@ -493,6 +493,84 @@ int twl_i2c_read_u8(u8 mod_no, u8 *value, u8 reg)
 }
 EXPORT_SYMBOL(twl_i2c_read_u8);
 
+/**
+ * twl_i2c_xfer_multi - Batch register accesses in TWL4030/TWL5030/TWL60X0
+ * @ops: the accesses, in bus order
+ * @num: number of entries in @ops, at most TWL_I2C_MULTI_MAX
+ *
+ * All accesses are issued as one combined i2c_transfer(), so the bus
+ * is arbitrated and the adapter woken only once however many modules
+ * (and slave addresses) are involved.
+ *
+ * Returns result of operation - 0 is success
+ */
+int twl_i2c_xfer_multi(struct twl_i2c_op *ops, int num)
+{
+	struct i2c_msg msgs[2 * TWL_I2C_MULTI_MAX];
+	u8 regs[TWL_I2C_MULTI_MAX];
+	struct i2c_adapter *adap = NULL;
+	int i, n = 0;
+	int ret;
+
+	if (unlikely(num > TWL_I2C_MULTI_MAX))
+		return -EINVAL;
+	if (unlikely(!inuse)) {
+		pr_err("%s: clients are not initialized\n", DRIVER_NAME);
+		return -EPERM;
+	}
+
+	for (i = 0; i < num; i++) {
+		struct twl_i2c_op *op = &ops[i];
+		struct twl_client *twl;
+
+		if (unlikely(op->mod_no > TWL_MODULE_LAST)) {
+			pr_err("%s: invalid module number %d\n", DRIVER_NAME,
+					op->mod_no);
+			return -EPERM;
+		}
+		twl = &twl_modules[twl_map[op->mod_no].sid];
+		adap = twl->client->adapter;
+
+		if (op->write) {
+			/* same layout as twl_i2c_write(): reg goes in byte 0 */
+			op->value[0] = twl_map[op->mod_no].base + op->reg;
+			msgs[n].addr = twl->address;
+			msgs[n].flags = 0;
+			msgs[n].len = op->num_bytes + 1;
+			msgs[n].buf = op->value;
+			n++;
+		} else {
+			regs[i] = twl_map[op->mod_no].base + op->reg;
+			msgs[n].addr = twl->address;
+			msgs[n].flags = 0;
+			msgs[n].len = 1;
+			msgs[n].buf = &regs[i];
+			n++;
+			msgs[n].addr = twl->address;
+			msgs[n].flags = I2C_M_RD;
+			msgs[n].len = op->num_bytes;
+			msgs[n].buf = op->value;
+			n++;
+		}
+	}
+	if (!n)
+		return 0;
+
+	ret = i2c_transfer(adap, msgs, n);
+
+	/* i2c_transfer returns number of messages transferred */
+	if (ret != n) {
+		pr_err("%s: i2c_xfer_multi failed to transfer all messages\n",
+			DRIVER_NAME);
+		if (ret < 0)
+			return ret;
+		else
+			return -EIO;
+	}
+	return 0;
+}
+EXPORT_SYMBOL(twl_i2c_xfer_multi);
+
 /*----------------------------------------------------------------------*/
 
 /**
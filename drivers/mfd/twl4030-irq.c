@@ -30,7 +30,6 @@
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/irq.h>
-#include <linux/kthread.h>
 #include <linux/slab.h>
 
 #include <linux/i2c/twl.h>
@@ -278,91 +277,119 @@ static const struct sih sih_modules_twl5031[8] = {
 
 static unsigned twl4030_irq_base;
 
-static struct completion irq_event;
+struct sih_agent {
+	int			irq_base;
+	const struct sih	*sih;
+
+	int			isr;		/* latched by the PIH thread */
+
+	u32			imr;
+	bool			imr_change_pending;
+
+	u32			edge_change;
+};
+
+/* indexed like sih_modules[], i.e. by PIH_ISR bit */
+static struct sih_agent *sih_agents[8];
 
 /*
- * This thread processes interrupts reported by the Primary Interrupt Handler.
+ * twl4030_irq_thread() is the threaded handler for the twl4030 interrupt.
+ * We can't do i2c transactions in interrupt context, so the line is
+ * requested IRQF_ONESHOT: it stays masked until this returns, and the
+ * genirq thread runs at SCHED_FIFO priority so PMIC events (power button,
+ * VBUS, keypad) aren't starved by ordinary I2C traffic.
+ *
+ * Once the PIH status tells us which SIH modules are asking, all of
+ * their ISRs are fetched -- and acked, they're clear-on-read -- in one
+ * combined I2C transaction rather than one transfer per module.
  */
-static int twl4030_irq_thread(void *data)
+static irqreturn_t twl4030_irq_thread(int irq, void *data)
 {
-	long irq = (long)data;
 	static unsigned i2c_errors;
 	static const unsigned max_i2c_errors = 100;
+	struct twl_i2c_op ops[ARRAY_SIZE(sih_agents)];
+	struct sih_agent *agents[ARRAY_SIZE(sih_agents)];
+	union {
+		u8	bytes[4];
+		u32	word;
+	} isr[ARRAY_SIZE(sih_agents)];
+	int ret;
+	int module_irq;
+	int i, n = 0;
+	u8 pih_isr, pending;
+
+	ret = twl_i2c_read_u8(TWL4030_MODULE_PIH, &pih_isr,
+				  REG_PIH_ISR_P1);
+	if (ret) {
+		pr_warning("twl4030: I2C error %d reading PIH ISR\n",
+				ret);
+		if (++i2c_errors >= max_i2c_errors) {
+			printk(KERN_ERR "Maximum I2C error count"
+					" exceeded.  Disabling %s.\n",
+					__func__);
+			disable_irq_nosync(irq);
+		}
+		/* still asserted, so unmasking it retries */
+		return IRQ_HANDLED;
+	}
 
+	for (i = 0, pending = pih_isr; pending; pending >>= 1, i++) {
+		struct sih_agent *agent = sih_agents[i];
+		struct irq_desc *d;
 
-	current->flags |= PF_NOFREEZE;
+		if (!(pending & 0x1) || !agent)
+			continue;
+
+		/* Leave the ISR of a disabled SIH module alone: reading it
+		 * would ack events nobody is going to handle.
+		 */
+		d = irq_to_desc(twl4030_irq_base + i);
+		if (!d || (d->status & IRQ_DISABLED))
+			continue;
 
-	while (!kthread_should_stop()) {
-		int ret;
-		int module_irq;
-		u8 pih_isr;
+		isr[n].word = 0;
+		ops[n].mod_no = agent->sih->module;
+		ops[n].reg = agent->sih->mask[irq_line].isr_offset;
+		ops[n].write = false;
+		ops[n].value = isr[n].bytes;
+		ops[n].num_bytes = agent->sih->bytes_ixr;
+		agents[n++] = agent;
+	}
 
-		/* Wait for IRQ, then read PIH irq status (also blocking) */
-		wait_for_completion_interruptible(&irq_event);
+	/* FIXME need retry-on-error ... */
+	ret = twl_i2c_xfer_multi(ops, n);
+	for (i = 0; i < n; i++)
+		agents[i]->isr = ret ? ret : le32_to_cpu(isr[i].word);
 
-		ret = twl_i2c_read_u8(TWL4030_MODULE_PIH, &pih_isr,
-					  REG_PIH_ISR_P1);
-		if (ret) {
-			pr_warning("twl4030: I2C error %d reading PIH ISR\n",
-					ret);
-			if (++i2c_errors >= max_i2c_errors) {
-				printk(KERN_ERR "Maximum I2C error count"
-						" exceeded.  Terminating %s.\n",
-						__func__);
+	/* these handlers deal with the relevant SIH irq status */
+	local_irq_disable();
+	for (module_irq = twl4030_irq_base;
+			pih_isr;
+			pih_isr >>= 1, module_irq++) {
+		if (pih_isr & 0x1) {
+			struct irq_desc *d = irq_to_desc(module_irq);
+
+			if (!d) {
+				pr_err("twl4030: Invalid SIH IRQ: %d\n",
+				       module_irq);
 				break;
 			}
-			complete(&irq_event);
-			continue;
-		}
 
-		/* these handlers deal with the relevant SIH irq status */
-		local_irq_disable();
-		for (module_irq = twl4030_irq_base;
-				pih_isr;
-				pih_isr >>= 1, module_irq++) {
-			if (pih_isr & 0x1) {
-				struct irq_desc *d = irq_to_desc(module_irq);
-
-				if (!d) {
-					pr_err("twl4030: Invalid SIH IRQ: %d\n",
-					       module_irq);
-					return -EINVAL;
-				}
-
-				/* These can't be masked ... always warn
-				 * if we get any surprises.
-				 */
-				if (d->status & IRQ_DISABLED)
-					note_interrupt(module_irq, d,
-							IRQ_NONE);
-				else
-					d->handle_irq(module_irq, d);
-			}
+			/* These can't be masked ... always warn
+			 * if we get any surprises.
+			 */
+			if (d->status & IRQ_DISABLED)
+				note_interrupt(module_irq, d,
+						IRQ_NONE);
+			else
+				d->handle_irq(module_irq, d);
 		}
-		local_irq_enable();
-
-		enable_irq(irq);
 	}
+	local_irq_enable();
 
-	return 0;
-}
-
-/*
- * handle_twl4030_pih() is the desc->handle method for the twl4030 interrupt.
- * This is a chained interrupt, so there is no desc->action method for it.
- * Now we need to query the interrupt controller in the twl4030 to determine
- * which module is generating the interrupt request.  However, we can't do i2c
- * transactions in interrupt context, so we must defer that work to a kernel
- * thread.  All we do here is acknowledge and mask the interrupt and wakeup
- * the kernel thread.
- */
-static irqreturn_t handle_twl4030_pih(int irq, void *devid)
-{
-	/* Acknowledge, clear *AND* mask the interrupt... */
-	disable_irq_nosync(irq);
-	complete(devid);
 	return IRQ_HANDLED;
 }
+
 /*----------------------------------------------------------------------*/
 
 /*
@@ -479,85 +506,11 @@ static inline void activate_irq(int irq)
 static DEFINE_SPINLOCK(sih_agent_lock);
 
 static struct workqueue_struct *wq;
+static struct work_struct sih_update_work;
 
-struct sih_agent {
-	int			irq_base;
-	const struct sih	*sih;
-
-	u32			imr;
-	bool			imr_change_pending;
-	struct work_struct	mask_work;
-
-	u32			edge_change;
-	struct work_struct	edge_work;
-};
-
-static void twl4030_sih_do_mask(struct work_struct *work)
-{
-	struct sih_agent	*agent;
-	const struct sih	*sih;
-	union {
-		u8	bytes[4];
-		u32	word;
-	}			imr;
-	int			status;
-
-	agent = container_of(work, struct sih_agent, mask_work);
-
-	/* see what work we have */
-	spin_lock_irq(&sih_agent_lock);
-	if (agent->imr_change_pending) {
-		sih = agent->sih;
-		/* byte[0] gets overwritten as we write ... */
-		imr.word = cpu_to_le32(agent->imr << 8);
-		agent->imr_change_pending = false;
-	} else
-		sih = NULL;
-	spin_unlock_irq(&sih_agent_lock);
-	if (!sih)
-		return;
-
-	/* write the whole mask ... simpler than subsetting it */
-	status = twl_i2c_write(sih->module, imr.bytes,
-			sih->mask[irq_line].imr_offset, sih->bytes_ixr);
-	if (status)
-		pr_err("twl4030: %s, %s --> %d\n", __func__,
-				"write", status);
-}
-
-static void twl4030_sih_do_edge(struct work_struct *work)
+/* Modify only the EDR bits we know must change */
+static int sih_update_edr(struct sih_agent *agent, u32 edge_change, u8 *bytes)
 {
-	struct sih_agent	*agent;
-	const struct sih	*sih;
-	u8			bytes[6];
-	u32			edge_change;
-	int			status;
-
-	agent = container_of(work, struct sih_agent, edge_work);
-
-	/* see what work we have */
-	spin_lock_irq(&sih_agent_lock);
-	edge_change = agent->edge_change;
-	agent->edge_change = 0;
-	sih = edge_change ? agent->sih : NULL;
-	spin_unlock_irq(&sih_agent_lock);
-	if (!sih)
-		return;
-
-	/* Read, reserving first byte for write scratch.  Yes, this
-	 * could be cached for some speedup ... but be careful about
-	 * any processor on the other IRQ line, EDR registers are
-	 * shared.
-	 */
-	status = twl_i2c_read(sih->module, bytes + 1,
-			sih->edr_offset, sih->bytes_edr);
-	if (status) {
-		pr_err("twl4030: %s, %s --> %d\n", __func__,
-				"read", status);
-		return;
-	}
-
-	/* Modify only the bits we know must change */
 	while (edge_change) {
 		int		i = fls(edge_change) - 1;
 		struct irq_desc	*d = irq_to_desc(i + agent->irq_base);
@@ -567,7 +520,7 @@ static void twl4030_sih_do_edge(struct work_struct *work)
 		if (!d) {
 			pr_err("twl4030: Invalid IRQ: %d\n",
 			       i + agent->irq_base);
-			return;
+			return -EINVAL;
 		}
 
 		bytes[byte] &= ~(0x03 << off);
@@ -582,9 +535,115 @@ static void twl4030_sih_do_edge(struct work_struct *work)
 		edge_change &= ~BIT(i);
 	}
 
-	/* Write */
-	status = twl_i2c_write(sih->module, bytes,
-			sih->edr_offset, sih->bytes_edr);
+	return 0;
+}
+
+/*
+ * Flush every agent's pending IMR and EDR updates.  Masking a handful of
+ * IRQs (say, around a suspend, or while a driver reconfigures) used to
+ * cost one I2C transfer per agent per register; now all EDRs that need
+ * a read-modify-write are read in one combined transaction, and all the
+ * resulting IMR and EDR writes go out in a second one.
+ */
+static void twl4030_sih_update(struct work_struct *work)
+{
+	struct twl_i2c_op	ops[2 * ARRAY_SIZE(sih_agents)];
+	struct twl_i2c_op	imr_ops[ARRAY_SIZE(sih_agents)];
+	struct {
+		struct sih_agent	*agent;
+		u32			edge_change;
+		u8			bytes[6];
+	}			edr[ARRAY_SIZE(sih_agents)];
+	union {
+		u8	bytes[4];
+		u32	word;
+	}			imr[ARRAY_SIZE(sih_agents)];
+	int			nr_edr = 0, nr_imr = 0, n = 0;
+	int			i, status;
+
+	/* see what work we have */
+	spin_lock_irq(&sih_agent_lock);
+	for (i = 0; i < ARRAY_SIZE(sih_agents); i++) {
+		struct sih_agent *agent = sih_agents[i];
+
+		if (!agent)
+			continue;
+
+		if (agent->edge_change) {
+			edr[nr_edr].agent = agent;
+			edr[nr_edr].edge_change = agent->edge_change;
+			agent->edge_change = 0;
+			nr_edr++;
+		}
+
+		if (agent->imr_change_pending) {
+			const struct sih *sih = agent->sih;
+
+			/* byte[0] gets overwritten as we write ... */
+			imr[nr_imr].word = cpu_to_le32(agent->imr << 8);
+			agent->imr_change_pending = false;
+
+			/* write the whole mask ... simpler than subsetting it */
+			imr_ops[nr_imr].mod_no = sih->module;
+			imr_ops[nr_imr].reg = sih->mask[irq_line].imr_offset;
+			imr_ops[nr_imr].write = true;
+			imr_ops[nr_imr].value = imr[nr_imr].bytes;
+			imr_ops[nr_imr].num_bytes = sih->bytes_ixr;
+			nr_imr++;
+		}
+	}
+	spin_unlock_irq(&sih_agent_lock);
+
+	if (nr_edr) {
+		struct twl_i2c_op rd[ARRAY_SIZE(sih_agents)];
+
+		/* Read, reserving first byte for write scratch.  Yes, this
+		 * could be cached for some speedup ... but be careful about
+		 * any processor on the other IRQ line, EDR registers are
+		 * shared.
+		 */
+		for (i = 0; i < nr_edr; i++) {
+			const struct sih *sih = edr[i].agent->sih;
+
+			rd[i].mod_no = sih->module;
+			rd[i].reg = sih->edr_offset;
+			rd[i].write = false;
+			rd[i].value = edr[i].bytes + 1;
+			rd[i].num_bytes = sih->bytes_edr;
+		}
+		status = twl_i2c_xfer_multi(rd, nr_edr);
+		if (status) {
+			pr_err("twl4030: %s, %s --> %d\n", __func__,
+					"read", status);
+
+			/* put the edge changes back for the next update */
+			spin_lock_irq(&sih_agent_lock);
+			for (i = 0; i < nr_edr; i++)
+				edr[i].agent->edge_change |= edr[i].edge_change;
+			spin_unlock_irq(&sih_agent_lock);
+			nr_edr = 0;
+		}
+
+		for (i = 0; i < nr_edr; i++) {
+			const struct sih *sih = edr[i].agent->sih;
+
+			if (sih_update_edr(edr[i].agent, edr[i].edge_change,
+					   edr[i].bytes))
+				continue;
+
+			ops[n].mod_no = sih->module;
+			ops[n].reg = sih->edr_offset;
+			ops[n].write = true;
+			ops[n].value = edr[i].bytes;
+			ops[n].num_bytes = sih->bytes_edr;
+			n++;
+		}
+	}
+
+	/* Write; trigger modes go out before the lines get unmasked */
+	for (i = 0; i < nr_imr; i++)
+		ops[n++] = imr_ops[i];
+	status = twl_i2c_xfer_multi(ops, n);
 	if (status)
 		pr_err("twl4030: %s, %s --> %d\n", __func__,
 				"write", status);
@@ -607,7 +666,7 @@ static void twl4030_sih_mask(unsigned irq)
 	spin_lock_irqsave(&sih_agent_lock, flags);
 	sih->imr |= BIT(irq - sih->irq_base);
 	sih->imr_change_pending = true;
-	queue_work(wq, &sih->mask_work);
+	queue_work(wq, &sih_update_work);
 	spin_unlock_irqrestore(&sih_agent_lock, flags);
 }
 
@@ -619,7 +678,7 @@ static void twl4030_sih_unmask(unsigned irq)
 	spin_lock_irqsave(&sih_agent_lock, flags);
 	sih->imr &= ~BIT(irq - sih->irq_base);
 	sih->imr_change_pending = true;
-	queue_work(wq, &sih->mask_work);
+	queue_work(wq, &sih_update_work);
 	spin_unlock_irqrestore(&sih_agent_lock, flags);
 }
 
@@ -642,7 +701,7 @@ static int twl4030_sih_set_type(unsigned irq, unsigned trigger)
 		desc->status &= ~IRQ_TYPE_SENSE_MASK;
 		desc->status |= trigger;
 		sih->edge_change |= BIT(irq - sih->irq_base);
-		queue_work(wq, &sih->edge_work);
+		queue_work(wq, &sih_update_work);
 	}
 	spin_unlock_irqrestore(&sih_agent_lock, flags);
 	return 0;
@@ -657,37 +716,18 @@ static struct irq_chip twl4030_sih_irq_chip = {
 
 /*----------------------------------------------------------------------*/
 
-static inline int sih_read_isr(const struct sih *sih)
-{
-	int status;
-	union {
-		u8 bytes[4];
-		u32 word;
-	} isr;
-
-	/* FIXME need retry-on-error ... */
-
-	isr.word = 0;
-	status = twl_i2c_read(sih->module, isr.bytes,
-			sih->mask[irq_line].isr_offset, sih->bytes_ixr);
-
-	return (status < 0) ? status : le32_to_cpu(isr.word);
-}
-
 /*
  * Generic handler for SIH interrupts ... we "know" this is called
- * in task context, with IRQs enabled.
+ * from the PIH thread, which has already read (and so, in clear-on-read
+ * mode, acked) this module's ISR.
  */
 static void handle_twl4030_sih(unsigned irq, struct irq_desc *desc)
 {
 	struct sih_agent *agent = get_irq_data(irq);
 	const struct sih *sih = agent->sih;
-	int isr;
+	int isr = agent->isr;
 
-	/* reading ISR acks the IRQs, using clear-on-read mode */
-	local_irq_enable();
-	isr = sih_read_isr(sih);
-	local_irq_disable();
+	agent->isr = 0;
 
 	if (isr < 0) {
 		pr_err("twl4030: %s SIH, read ISR error %d\n",
@@ -748,8 +788,6 @@ int twl4030_sih_setup(int module)
 	agent->irq_base = irq_base;
 	agent->sih = sih;
 	agent->imr = ~0;
-	INIT_WORK(&agent->mask_work, twl4030_sih_do_mask);
-	INIT_WORK(&agent->edge_work, twl4030_sih_do_edge);
 
 	for (i = 0; i < sih->bits; i++) {
 		irq = irq_base + i;
@@ -766,6 +804,7 @@ int twl4030_sih_setup(int module)
 	/* replace generic PIH handler (handle_simple_irq) */
 	irq = sih_mod + twl4030_irq_base;
 	set_irq_data(irq, agent);
+	sih_agents[sih_mod] = agent;
 	set_irq_chained_handler(irq, handle_twl4030_sih);
 
 	pr_info("twl4030: %s (irq %d) chaining IRQs %d..%d\n", sih->name,
@@ -788,7 +827,6 @@ int twl4030_init_irq(int irq_num, unsigned irq_base, unsigned irq_end)
 
 	int			status;
 	int			i;
-	struct task_struct	*task;
 
 	/*
 	 * Mask and clear all TWL4030 interrupts since initially we do
@@ -803,6 +841,7 @@ int twl4030_init_irq(int irq_num, unsigned irq_base, unsigned irq_end)
 		pr_err("twl4030: workqueue FAIL\n");
 		return -ESRCH;
 	}
+	INIT_WORK(&sih_update_work, twl4030_sih_update);
 
 	twl4030_irq_base = irq_base;
 
@@ -831,27 +870,14 @@ int twl4030_init_irq(int irq_num, unsigned irq_base, unsigned irq_end)
 	}
 
 	/* install an irq handler to demultiplex the TWL4030 interrupt */
-
-
-	init_completion(&irq_event);
-
-	status = request_irq(irq_num, handle_twl4030_pih, IRQF_DISABLED,
-				"TWL4030-PIH", &irq_event);
+	status = request_threaded_irq(irq_num, NULL, twl4030_irq_thread,
+				IRQF_ONESHOT, "TWL4030-PIH", NULL);
 	if (status < 0) {
 		pr_err("twl4030: could not claim irq%d: %d\n", irq_num, status);
 		goto fail_rqirq;
 	}
 
-	task = kthread_run(twl4030_irq_thread, (void *)(long)irq_num,
-								"twl4030-irq");
-	if (IS_ERR(task)) {
-		pr_err("twl4030: could not create irq %d thread!\n", irq_num);
-		status = PTR_ERR(task);
-		goto fail_kthread;
-	}
 	return status;
-fail_kthread:
-	free_irq(irq_num, &irq_event);
 fail_rqirq:
 	/* clean up twl4030_sih_setup */
 fail:
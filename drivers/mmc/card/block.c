@@ -31,6 +31,10 @@
 #include <linux/mutex.h>
 #include <linux/scatterlist.h>
 #include <linux/string_helpers.h>
+#include <linux/list.h>
+#include <linux/jiffies.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -65,6 +69,74 @@ static int max_devices;
 /* 256 minors, so at most 256 separate devices */
 static DECLARE_BITMAP(dev_use, 256);
 
+/*
+ * Discards are not sent to the card as they come in: each erase can keep
+ * an SD card busy for hundreds of milliseconds.  Instead the freed range
+ * is remembered, merged with its neighbours so whole erase groups get
+ * covered, and erased from the queue thread once the device has been
+ * idle for a while.  The list is only ever touched by the queue thread.
+ */
+#define MMC_BLK_DISCARD_MAX_RANGES	256
+#define MMC_BLK_DISCARD_IDLE_MS		100
+
+struct mmc_blk_discard {
+	struct list_head	list;
+	unsigned int		from;
+	unsigned int		nr;
+};
+
+struct mmc_blk_discard_stats {
+	unsigned long		queued;		/* requests deferred */
+	unsigned long		merged;		/* ... that joined a range */
+	unsigned long		issued;		/* erase/trim commands sent */
+	unsigned long long	issued_sectors;
+	unsigned long long	cancelled_sectors; /* overwritten first */
+	unsigned long		sync;		/* could not be deferred */
+	unsigned long		errors;
+};
+
+/*
+ * eMMC 4.5 packed writes: a run of small write requests waiting in the
+ * queue is sent as a single CMD23/CMD25 transfer.  The first block is a
+ * header listing the address and length of every entry, the data of the
+ * entries follows back to back.  Cards spend much of the time of a small
+ * write on per-command overhead, which the pack only pays once.
+ */
+#define MMC_BLK_PACKED_VER		0x01
+#define MMC_BLK_PACKED_WR		0x02
+#define MMC_BLK_PACKED_HDR_SIZE		512
+/* one 8 byte slot per entry, the first slot holds the header itself */
+#define MMC_BLK_PACKED_MAX_ENTRIES	(MMC_BLK_PACKED_HDR_SIZE / 8 - 1)
+#define MMC_BLK_PACKED_MAX_SECTORS	64	/* larger writes go alone */
+#define MMC_BLK_PACKED_MAX_ERRORS	3
+
+enum mmc_blk_packed_stop {
+	MMC_BLK_PACKED_STOP_EMPTY,	/* nothing else queued */
+	MMC_BLK_PACKED_STOP_NOT_WRITE,	/* read, discard or flush next */
+	MMC_BLK_PACKED_STOP_TOO_BIG,	/* next write is not small */
+	MMC_BLK_PACKED_STOP_ENTRIES,
+	MMC_BLK_PACKED_STOP_BLOCKS,	/* host transfer size limit */
+	MMC_BLK_PACKED_STOP_SEGS,	/* host segment limit */
+	MMC_BLK_PACKED_STOP_NR,
+};
+
+static const char *mmc_blk_packed_stop_names[MMC_BLK_PACKED_STOP_NR] = {
+	"empty", "not_write", "too_big", "entries", "blocks", "segs",
+};
+
+struct mmc_blk_rw_stats {
+	unsigned long		reads;
+	unsigned long		writes;
+	unsigned long		rel_writes;	/* sent with REQ_FUA */
+	unsigned long		flushes;
+	unsigned long		packs;		/* packed commands sent */
+	unsigned long		packed_reqs;	/* requests carried by them */
+	unsigned long long	packed_sectors;
+	unsigned long		packed_errors;	/* packs redone one by one */
+	unsigned long		stop[MMC_BLK_PACKED_STOP_NR];
+	unsigned long		entries[MMC_BLK_PACKED_MAX_ENTRIES + 1];
+};
+
 /*
  * There is one mmc_blk_data per slot.
  */
@@ -75,6 +147,25 @@ struct mmc_blk_data {
 
 	unsigned int	usage;
 	unsigned int	read_only;
+
+	struct list_head discard_list;		/* sorted, non-overlapping */
+	unsigned int	discard_ranges;
+	unsigned int	discard_pending;	/* sectors */
+	unsigned long	discard_last_io;	/* jiffies */
+	unsigned int	discard_background;
+	unsigned int	discard_zeroes_data;	/* card erases to zeroes */
+	unsigned int	discard_idle_ms;
+	unsigned int	discard_chunk;		/* sectors per command, 0: any */
+	struct mmc_blk_discard_stats discard_stats;
+
+	unsigned int	rel_wr;			/* REQ_FUA as reliable write */
+	unsigned int	packed_max_entries;	/* 0: packing off */
+	unsigned int	packed_max_sectors;	/* per packed request */
+	unsigned int	packed_errors;		/* in a row */
+	u32		*packed_hdr;
+	struct scatterlist *packed_sg;
+	struct mmc_blk_rw_stats rw_stats;
+	struct dentry	*debugfs_root;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -82,6 +173,14 @@ static DEFINE_MUTEX(open_lock);
 module_param(perdev_minors, int, 0444);
 MODULE_PARM_DESC(perdev_minors, "Minors numbers to allocate per device");
 
+static void mmc_blk_discard_free(struct mmc_blk_data *md,
+				 struct mmc_blk_discard *d)
+{
+	list_del(&d->list);
+	md->discard_ranges--;
+	kfree(d);
+}
+
 static struct mmc_blk_data *mmc_blk_get(struct gendisk *disk)
 {
 	struct mmc_blk_data *md;
@@ -110,6 +209,18 @@ static void mmc_blk_put(struct mmc_blk_data *md)
 
 		blk_cleanup_queue(md->queue.queue);
 
+		kfree(md->packed_sg);
+		kfree(md->packed_hdr);
+
+		/*
+		 * Normally empty: remove flushed the list before stopping
+		 * the queue thread.  Only a failed probe gets here with
+		 * ranges left, and then there is no card to erase them on.
+		 */
+		while (!list_empty(&md->discard_list))
+			mmc_blk_discard_free(md, list_first_entry(
+				&md->discard_list, struct mmc_blk_discard, list));
+
 		__clear_bit(devidx, dev_use);
 
 		put_disk(md->disk);
@@ -167,6 +278,7 @@ static const struct block_device_operations mmc_bdops = {
 
 struct mmc_blk_request {
 	struct mmc_request	mrq;
+	struct mmc_command	sbc;
 	struct mmc_command	cmd;
 	struct mmc_command	stop;
 	struct mmc_data		data;
@@ -262,6 +374,263 @@ static u32 get_card_status(struct mmc_card *card, struct request *req)
 	return cmd.resp[0];
 }
 
+/*
+ * Add [from, from + nr) to the pending list, merging it with any range
+ * it touches.  Fails when a new entry is needed and can't be had, in
+ * which case the caller erases synchronously as before.
+ */
+static int mmc_blk_discard_add(struct mmc_blk_data *md, unsigned int from,
+			       unsigned int nr)
+{
+	unsigned int to = from + nr;
+	struct mmc_blk_discard *d, *next;
+
+	list_for_each_entry(d, &md->discard_list, list) {
+		unsigned int end = d->from + d->nr;
+
+		if (end < from)
+			continue;
+		if (to < d->from)
+			break;
+
+		/* touches or overlaps: grow d, then swallow what follows */
+		md->discard_pending -= d->nr;
+		d->from = min(d->from, from);
+		end = max(end, to);
+		next = list_entry(d->list.next, struct mmc_blk_discard, list);
+		while (&next->list != &md->discard_list && next->from <= end) {
+			struct mmc_blk_discard *gone = next;
+
+			next = list_entry(next->list.next,
+					  struct mmc_blk_discard, list);
+			end = max(end, gone->from + gone->nr);
+			md->discard_pending -= gone->nr;
+			mmc_blk_discard_free(md, gone);
+		}
+		d->nr = end - d->from;
+		md->discard_pending += d->nr;
+		md->discard_stats.merged++;
+		return 0;
+	}
+
+	if (md->discard_ranges >= MMC_BLK_DISCARD_MAX_RANGES)
+		return -ENOSPC;
+
+	next = kmalloc(sizeof(*next), GFP_NOIO);
+	if (!next)
+		return -ENOMEM;
+
+	next->from = from;
+	next->nr = nr;
+	/* before d, or at the tail if the walk ran off the end */
+	list_add_tail(&next->list, &d->list);
+	md->discard_ranges++;
+	md->discard_pending += nr;
+	return 0;
+}
+
+/*
+ * Take [from, from + nr) off the pending list, returning how many
+ * pending sectors that covered.
+ */
+static unsigned int mmc_blk_discard_cut(struct mmc_blk_data *md,
+					unsigned int from, unsigned int nr)
+{
+	unsigned int to = from + nr;
+	unsigned int total = 0;
+	struct mmc_blk_discard *d, *tmp;
+
+	list_for_each_entry_safe(d, tmp, &md->discard_list, list) {
+		unsigned int end = d->from + d->nr;
+		unsigned int cut;
+
+		if (end <= from)
+			continue;
+		if (d->from >= to)
+			break;
+
+		cut = min(end, to) - max(d->from, from);
+		md->discard_pending -= cut;
+		total += cut;
+
+		if (d->from < from && end > to) {
+			struct mmc_blk_discard *tail;
+
+			/* punch a hole; losing the tail is harmless */
+			d->nr = from - d->from;
+			tail = kmalloc(sizeof(*tail), GFP_NOIO);
+			if (!tail) {
+				md->discard_pending -= end - to;
+				break;
+			}
+			tail->from = to;
+			tail->nr = end - to;
+			list_add(&tail->list, &d->list);
+			md->discard_ranges++;
+			break;
+		} else if (d->from < from) {
+			d->nr = from - d->from;
+		} else if (end > to) {
+			d->nr = end - to;
+			d->from = to;
+		} else {
+			mmc_blk_discard_free(md, d);
+		}
+	}
+	return total;
+}
+
+/*
+ * Forget the pending part of [from, from + nr): it is about to be
+ * written (or securely erased), and erasing it afterwards would destroy
+ * the new contents.
+ */
+static void mmc_blk_discard_cancel(struct mmc_blk_data *md, unsigned int from,
+				   unsigned int nr)
+{
+	md->discard_stats.cancelled_sectors += mmc_blk_discard_cut(md, from, nr);
+}
+
+static int mmc_blk_discard_erase(struct mmc_blk_data *md, unsigned int from,
+				 unsigned int nr)
+{
+	struct mmc_card *card = md->queue.card;
+	unsigned int arg;
+	int err;
+
+	if (mmc_can_trim(card))
+		arg = MMC_TRIM_ARG;
+	else
+		arg = MMC_ERASE_ARG;
+
+	mmc_claim_host(card->host);
+	err = mmc_erase(card, from, nr, arg);
+	mmc_release_host(card->host);
+
+	md->discard_stats.issued++;
+	md->discard_stats.issued_sectors += nr;
+	if (err)
+		md->discard_stats.errors++;
+
+	return err;
+}
+
+/*
+ * Erase (at most @max sectors of, 0 meaning all of) a pending range.
+ * Chunks end on an erase group boundary so no partial group is left
+ * behind.
+ */
+static int mmc_blk_discard_issue(struct mmc_blk_data *md,
+				 struct mmc_blk_discard *d, unsigned int max)
+{
+	struct mmc_card *card = md->queue.card;
+	unsigned int nr = d->nr;
+	int err;
+
+	if (max && nr > max) {
+		nr = max;
+		if (card->erase_size && nr > card->erase_size)
+			nr -= (d->from + nr) % card->erase_size;
+	}
+
+	err = mmc_blk_discard_erase(md, d->from, nr);
+
+	d->from += nr;
+	d->nr -= nr;
+	md->discard_pending -= nr;
+	if (!d->nr)
+		mmc_blk_discard_free(md, d);
+
+	return err;
+}
+
+/*
+ * Erase everything still pending.  The list belongs to the queue
+ * thread, so the caller must have parked it with mmc_queue_suspend().
+ */
+static void mmc_blk_discard_flush(struct mmc_blk_data *md)
+{
+	while (!list_empty(&md->discard_list))
+		mmc_blk_discard_issue(md, list_first_entry(&md->discard_list,
+					struct mmc_blk_discard, list), 0);
+}
+
+/*
+ * Ranges deferred before discard_background was switched off can still
+ * be pending once discard_zeroes_data is advertised again.  A read must
+ * not see their old data then, so erase the part it overlaps, widened to
+ * whole erase groups when the card can't trim.
+ */
+static void mmc_blk_discard_before_read(struct mmc_blk_data *md,
+					unsigned int from, unsigned int nr)
+{
+	struct mmc_card *card = md->queue.card;
+	unsigned int to = from + nr;
+	struct mmc_blk_discard *d, *tmp;
+
+	if (!md->queue.queue->limits.discard_zeroes_data)
+		return;
+
+	list_for_each_entry_safe(d, tmp, &md->discard_list, list) {
+		unsigned int end = d->from + d->nr;
+		unsigned int start, stop, rem;
+
+		if (end <= from)
+			continue;
+		if (d->from >= to)
+			break;
+
+		start = max(d->from, from);
+		stop = min(end, to);
+		if (!mmc_can_trim(card) && card->erase_size) {
+			start = max(d->from, start - start % card->erase_size);
+			rem = stop % card->erase_size;
+			if (rem)
+				stop = min(end, stop + card->erase_size - rem);
+		}
+
+		mmc_blk_discard_erase(md, start, stop - start);
+		mmc_blk_discard_cut(md, start, stop - start);
+	}
+}
+
+/*
+ * A deferred discard hasn't reached the card when it completes, and is
+ * lost outright if power goes first, so discard_zeroes_data can only be
+ * advertised while discards are issued synchronously.
+ */
+static void mmc_blk_update_discard_zeroes(struct mmc_blk_data *md)
+{
+	md->queue.queue->limits.discard_zeroes_data =
+		md->discard_zeroes_data && !md->discard_background;
+}
+
+static long mmc_blk_discard_due(struct mmc_queue *mq)
+{
+	struct mmc_blk_data *md = mq->data;
+	unsigned long due;
+
+	if (list_empty(&md->discard_list))
+		return MAX_SCHEDULE_TIMEOUT;
+	if (!md->discard_background)
+		return 0;
+
+	due = md->discard_last_io + msecs_to_jiffies(md->discard_idle_ms);
+	if (time_after_eq(jiffies, due))
+		return 0;
+	return due - jiffies;
+}
+
+static void mmc_blk_discard_idle(struct mmc_queue *mq)
+{
+	struct mmc_blk_data *md = mq->data;
+
+	if (!list_empty(&md->discard_list))
+		mmc_blk_discard_issue(md, list_first_entry(&md->discard_list,
+					struct mmc_blk_discard, list),
+				      md->discard_chunk);
+}
+
 static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -269,6 +638,21 @@ static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 	unsigned int from, nr, arg;
 	int err = 0;
 
+	from = blk_rq_pos(req);
+	nr = blk_rq_sectors(req);
+
+	if (md->discard_background && mmc_can_erase(card) &&
+	    !md->queue.queue->limits.discard_zeroes_data) {
+		if (!mmc_blk_discard_add(md, from, nr)) {
+			md->discard_stats.queued++;
+			spin_lock_irq(&md->lock);
+			__blk_end_request(req, 0, blk_rq_bytes(req));
+			spin_unlock_irq(&md->lock);
+			return 1;
+		}
+		md->discard_stats.sync++;
+	}
+
 	mmc_claim_host(card->host);
 
 	if (!mmc_can_erase(card)) {
@@ -276,9 +660,6 @@ static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 		goto out;
 	}
 
-	from = blk_rq_pos(req);
-	nr = blk_rq_sectors(req);
-
 	if (mmc_can_trim(card))
 		arg = MMC_TRIM_ARG;
 	else
@@ -331,17 +712,62 @@ out:
 	return err ? 0 : 1;
 }
 
+/*
+ * Wait for the card to leave the programming state after a write.
+ */
+static int mmc_blk_wait_prog_done(struct mmc_card *card, struct request *req)
+{
+	struct mmc_command cmd;
+	int err;
+
+	do {
+		cmd.opcode = MMC_SEND_STATUS;
+		cmd.arg = card->rca << 16;
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		err = mmc_wait_for_cmd(card->host, &cmd, 5);
+		if (err) {
+			printk(KERN_ERR "%s: error %d requesting status\n",
+			       req->rq_disk->disk_name, err);
+			return err;
+		}
+		/*
+		 * Some cards mishandle the status bits,
+		 * so make sure to check both the busy
+		 * indication and the card state.
+		 */
+	} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+		(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+
+#if 0
+	if (cmd.resp[0] & ~0x00000900)
+		printk(KERN_ERR "%s: status = %08x\n",
+		       req->rq_disk->disk_name, cmd.resp[0]);
+	if (mmc_decode_status(cmd.resp))
+		return -EIO;
+#endif
+	return 0;
+}
+
 static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
 	struct mmc_blk_request brq;
 	int ret = 1, disable_multi = 0;
+	/*
+	 * Reliable writes go through CMD23, which also ends the transfer
+	 * so no CMD12 is sent.  Only cards that can do them at any size
+	 * and alignment get md->rel_wr set.
+	 */
+	int do_rel_wr = md->rel_wr && rq_data_dir(req) == WRITE &&
+			(req->cmd_flags & REQ_FUA);
+
+	if (do_rel_wr)
+		md->rw_stats.rel_writes++;
 
 	mmc_claim_host(card->host);
 
 	do {
-		struct mmc_command cmd;
 		u32 readcmd, writecmd, status = 0;
 
 		memset(&brq, 0, sizeof(struct mmc_blk_request));
@@ -374,7 +800,14 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		if (disable_multi && brq.data.blocks > 1)
 			brq.data.blocks = 1;
 
-		if (brq.data.blocks > 1) {
+		if (do_rel_wr) {
+			brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
+			brq.sbc.arg = MMC_CMD23_ARG_REL_WR | brq.data.blocks;
+			brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			brq.mrq.stop = NULL;
+			readcmd = MMC_READ_MULTIPLE_BLOCK;
+			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+		} else if (brq.data.blocks > 1) {
 			/* SPI multiblock writes terminate using a special
 			 * token, not a STOP_TRANSMISSION request.
 			 */
@@ -420,6 +853,17 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 			brq.data.sg_len = i;
 		}
 
+		if (do_rel_wr) {
+			mmc_wait_for_cmd(card->host, &brq.sbc, 0);
+			if (brq.sbc.error) {
+				printk(KERN_ERR "%s: error %d sending set block "
+				       "count, response %#x\n",
+				       req->rq_disk->disk_name, brq.sbc.error,
+				       brq.sbc.resp[0]);
+				goto cmd_err;
+			}
+		}
+
 		mmc_queue_bounce_pre(mq);
 
 		mmc_wait_for_req(card->host, &brq.mrq);
@@ -467,35 +911,9 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 			       brq.stop.resp[0], status);
 		}
 
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			do {
-				int err;
-
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-				err = mmc_wait_for_cmd(card->host, &cmd, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					goto cmd_err;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7));
-
-#if 0
-			if (cmd.resp[0] & ~0x00000900)
-				printk(KERN_ERR "%s: status = %08x\n",
-				       req->rq_disk->disk_name, cmd.resp[0]);
-			if (mmc_decode_status(cmd.resp))
-				goto cmd_err;
-#endif
-		}
+		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ &&
+		    mmc_blk_wait_prog_done(card, req))
+			goto cmd_err;
 
 		if (brq.cmd.error || brq.stop.error || brq.data.error) {
 			if (rq_data_dir(req) == READ) {
@@ -558,14 +976,253 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 	return 0;
 }
 
+static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+
+	/*
+	 * We only ask for flushes on cards without a volatile cache:
+	 * data is on the medium once the card has left the programming
+	 * state, which every write already waits for.
+	 */
+	md->rw_stats.flushes++;
+	spin_lock_irq(&md->lock);
+	__blk_end_request_all(req, 0);
+	spin_unlock_irq(&md->lock);
+
+	return 1;
+}
+
+/*
+ * Move the small writes queued behind @req onto @list, after @req, for
+ * as long as they fit in one packed command.  Returns the number of
+ * requests on @list and their total size in @sectors.
+ */
+static unsigned int mmc_blk_packed_fetch(struct mmc_queue *mq,
+		struct request *req, struct list_head *list,
+		unsigned int *sectors)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_host *host = mq->card->host;
+	struct request_queue *q = mq->queue;
+	enum mmc_blk_packed_stop stop;
+	unsigned int max_entries, max_blocks, max_segs, segs, nr = 1;
+	struct request *next;
+
+	max_entries = min_t(unsigned int, md->packed_max_entries,
+			    MMC_BLK_PACKED_MAX_ENTRIES);
+	/* the header takes a block and a segment of its own */
+	max_blocks = min(host->max_blk_count, host->max_req_size >> 9) - 1;
+	max_segs = host->max_segs - 1;
+
+	*sectors = blk_rq_sectors(req);
+	segs = req->nr_phys_segments;
+	list_add_tail(&req->queuelist, list);
+	if (*sectors > max_blocks || segs > max_segs) {
+		md->rw_stats.stop[MMC_BLK_PACKED_STOP_TOO_BIG]++;
+		return nr;
+	}
+
+	spin_lock_irq(q->queue_lock);
+	while (1) {
+		if (nr >= max_entries) {
+			stop = MMC_BLK_PACKED_STOP_ENTRIES;
+			break;
+		}
+		next = blk_queue_plugged(q) ? NULL : blk_peek_request(q);
+		if (!next) {
+			stop = MMC_BLK_PACKED_STOP_EMPTY;
+			break;
+		}
+		if (rq_data_dir(next) != WRITE ||
+		    (next->cmd_flags & (REQ_DISCARD | REQ_FLUSH))) {
+			stop = MMC_BLK_PACKED_STOP_NOT_WRITE;
+			break;
+		}
+		if (blk_rq_sectors(next) > md->packed_max_sectors) {
+			stop = MMC_BLK_PACKED_STOP_TOO_BIG;
+			break;
+		}
+		if (*sectors + blk_rq_sectors(next) > max_blocks) {
+			stop = MMC_BLK_PACKED_STOP_BLOCKS;
+			break;
+		}
+		if (segs + next->nr_phys_segments > max_segs) {
+			stop = MMC_BLK_PACKED_STOP_SEGS;
+			break;
+		}
+
+		blk_start_request(next);
+		list_add_tail(&next->queuelist, list);
+		*sectors += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+		nr++;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	md->rw_stats.stop[stop]++;
+	md->rw_stats.writes += nr - 1;
+
+	return nr;
+}
+
+static int mmc_blk_issue_packed_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request brq;
+	struct request *prq, *tmp;
+	unsigned int nr, sectors, sg_len, i;
+	u32 *hdr = md->packed_hdr;
+	LIST_HEAD(list);
+	int err, ret;
+
+	nr = mmc_blk_packed_fetch(mq, req, &list, &sectors);
+	if (nr == 1) {
+		list_del_init(&req->queuelist);
+		return mmc_blk_issue_rw_rq(mq, req);
+	}
+
+	memset(hdr, 0, MMC_BLK_PACKED_HDR_SIZE);
+	hdr[0] = cpu_to_le32((nr << 16) | (MMC_BLK_PACKED_WR << 8) |
+			     MMC_BLK_PACKED_VER);
+
+	sg_init_table(md->packed_sg, card->host->max_segs);
+	sg_set_buf(md->packed_sg, hdr, MMC_BLK_PACKED_HDR_SIZE);
+	sg_len = 1;
+
+	i = 1;
+	list_for_each_entry(prq, &list, queuelist) {
+		u32 arg = blk_rq_sectors(prq);
+		u32 addr = blk_rq_pos(prq);
+
+		if (md->rel_wr && (prq->cmd_flags & REQ_FUA)) {
+			arg |= MMC_CMD23_ARG_REL_WR;
+			md->rw_stats.rel_writes++;
+		}
+		if (!mmc_card_blockaddr(card))
+			addr <<= 9;
+		hdr[i * 2] = cpu_to_le32(arg);
+		hdr[i * 2 + 1] = cpu_to_le32(addr);
+		i++;
+
+		if (prq != req && !list_empty(&md->discard_list))
+			mmc_blk_discard_cancel(md, blk_rq_pos(prq),
+					       blk_rq_sectors(prq));
+
+		/* blk_rq_map_sg() terminates what it built, keep going */
+		sg_unmark_end(&md->packed_sg[sg_len - 1]);
+		sg_len += blk_rq_map_sg(mq->queue, prq,
+					&md->packed_sg[sg_len]);
+	}
+
+	memset(&brq, 0, sizeof(struct mmc_blk_request));
+	brq.mrq.cmd = &brq.cmd;
+	brq.mrq.data = &brq.data;
+
+	/* the block count includes the header */
+	brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq.sbc.arg = MMC_CMD23_ARG_PACKED | (sectors + 1);
+	brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	/* ... and the transfer starts at the first entry */
+	brq.cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq.cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq.cmd.arg <<= 9;
+	brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq.data.blksz = 512;
+	brq.data.blocks = sectors + 1;
+	brq.data.flags = MMC_DATA_WRITE;
+	brq.data.sg = md->packed_sg;
+	brq.data.sg_len = sg_len;
+	mmc_set_data_timeout(&brq.data, card);
+
+	mmc_claim_host(card->host);
+	err = mmc_wait_for_cmd(card->host, &brq.sbc, 0);
+	if (!err) {
+		mmc_wait_for_req(card->host, &brq.mrq);
+		err = brq.cmd.error ? brq.cmd.error : brq.data.error;
+		/* the card may be programming even after an error */
+		if (mmc_blk_wait_prog_done(card, req) && !err)
+			err = -EIO;
+	}
+	mmc_release_host(card->host);
+
+	if (!err) {
+		md->packed_errors = 0;
+		md->rw_stats.packs++;
+		md->rw_stats.packed_reqs += nr;
+		md->rw_stats.packed_sectors += sectors;
+		md->rw_stats.entries[nr]++;
+
+		spin_lock_irq(&md->lock);
+		list_for_each_entry_safe(prq, tmp, &list, queuelist) {
+			list_del_init(&prq->queuelist);
+			__blk_end_request_all(prq, 0);
+		}
+		spin_unlock_irq(&md->lock);
+		return 1;
+	}
+
+	/*
+	 * We can't tell how far the card got.  Writing the entries again,
+	 * in the same order, ends up with the same contents, so redo them
+	 * one request at a time through the normal path, which also does
+	 * the error handling.  Cards that keep failing don't get packs.
+	 */
+	printk(KERN_WARNING "%s: error %d sending packed write of %u "
+	       "requests, retrying one by one\n",
+	       req->rq_disk->disk_name, err, nr);
+	md->rw_stats.packed_errors++;
+	if (++md->packed_errors >= MMC_BLK_PACKED_MAX_ERRORS) {
+		printk(KERN_WARNING "%s: disabling packed writes\n",
+		       req->rq_disk->disk_name);
+		md->packed_max_entries = 0;
+	}
+
+	ret = 1;
+	list_for_each_entry_safe(prq, tmp, &list, queuelist) {
+		list_del_init(&prq->queuelist);
+		mq->req = prq;
+		if (!mmc_blk_issue_rw_rq(mq, prq))
+			ret = 0;
+	}
+	return ret;
+}
+
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
+	struct mmc_blk_data *md = mq->data;
+
 	if (req->cmd_flags & REQ_DISCARD) {
-		if (req->cmd_flags & REQ_SECURE)
+		if (req->cmd_flags & REQ_SECURE) {
+			mmc_blk_discard_cancel(md, blk_rq_pos(req),
+					       blk_rq_sectors(req));
 			return mmc_blk_issue_secdiscard_rq(mq, req);
-		else
+		} else
 			return mmc_blk_issue_discard_rq(mq, req);
+	} else if ((req->cmd_flags & REQ_FLUSH) && !blk_rq_sectors(req)) {
+		return mmc_blk_issue_flush(mq, req);
 	} else {
+		md->discard_last_io = jiffies;
+		if (!list_empty(&md->discard_list)) {
+			if (rq_data_dir(req) == WRITE)
+				mmc_blk_discard_cancel(md, blk_rq_pos(req),
+						       blk_rq_sectors(req));
+			else
+				mmc_blk_discard_before_read(md,
+					blk_rq_pos(req), blk_rq_sectors(req));
+		}
+		if (rq_data_dir(req) == READ) {
+			md->rw_stats.reads++;
+		} else {
+			md->rw_stats.writes++;
+			if (md->packed_hdr && md->packed_max_entries > 1 &&
+			    blk_rq_sectors(req) <= md->packed_max_sectors)
+				return mmc_blk_issue_packed_rq(mq, req);
+		}
 		return mmc_blk_issue_rw_rq(mq, req);
 	}
 }
@@ -608,13 +1265,53 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	spin_lock_init(&md->lock);
 	md->usage = 1;
 
+	INIT_LIST_HEAD(&md->discard_list);
+	md->discard_background = 1;
+	md->discard_idle_ms = MMC_BLK_DISCARD_IDLE_MS;
+	md->discard_chunk = card->pref_erase;
+
 	ret = mmc_init_queue(&md->queue, card, &md->lock);
 	if (ret)
 		goto err_putdisk;
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
+	md->queue.idle_due = mmc_blk_discard_due;
+	md->queue.idle_fn = mmc_blk_discard_idle;
 	md->queue.data = md;
 
+	md->discard_zeroes_data = md->queue.queue->limits.discard_zeroes_data;
+	mmc_blk_update_discard_zeroes(md);
+
+	/*
+	 * Both reliable and packed writes are set up with CMD23, which
+	 * SPI mode doesn't have.  Packing maps the requests' own pages,
+	 * so it can't work through the bounce buffer either.
+	 */
+	if (mmc_card_mmc(card) && !mmc_host_is_spi(card->host)) {
+		if (card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN) {
+			md->rel_wr = 1;
+			blk_queue_flush(md->queue.queue, REQ_FLUSH | REQ_FUA);
+		}
+
+		if (card->ext_csd.max_packed_writes > 1 &&
+		    !md->queue.bounce_buf && card->host->max_segs > 1) {
+			md->packed_hdr = kmalloc(MMC_BLK_PACKED_HDR_SIZE,
+						 GFP_KERNEL);
+			md->packed_sg = kmalloc(sizeof(struct scatterlist) *
+					card->host->max_segs, GFP_KERNEL);
+			if (md->packed_hdr && md->packed_sg) {
+				md->packed_max_entries =
+					card->ext_csd.max_packed_writes;
+			} else {
+				kfree(md->packed_sg);
+				kfree(md->packed_hdr);
+				md->packed_sg = NULL;
+				md->packed_hdr = NULL;
+			}
+		}
+	}
+	md->packed_max_sectors = MMC_BLK_PACKED_MAX_SECTORS;
+
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx * perdev_minors;
 	md->disk->fops = &mmc_bdops;
@@ -681,6 +1378,177 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card)
 	return 0;
 }
 
+/*
+ * Background discard tuning and statistics, under /sys/block/mmcblkN/.
+ */
+#define MMC_BLK_DISCARD_ATTR(_name, _field, _conv_show, _conv_store)	\
+static ssize_t mmc_blk_##_name##_show(struct device *dev,		\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct mmc_blk_data *md = dev_to_disk(dev)->private_data;	\
+	unsigned int val = md->_field;					\
+	return sprintf(buf, "%u\n", _conv_show);			\
+}									\
+static ssize_t mmc_blk_##_name##_store(struct device *dev,		\
+		struct device_attribute *attr, const char *buf, size_t count) \
+{									\
+	struct mmc_blk_data *md = dev_to_disk(dev)->private_data;	\
+	unsigned long val;						\
+	if (strict_strtoul(buf, 0, &val))				\
+		return -EINVAL;						\
+	md->_field = _conv_store;					\
+	wake_up_process(md->queue.thread);				\
+	return count;							\
+}									\
+static DEVICE_ATTR(_name, S_IRUGO | S_IWUSR,				\
+		   mmc_blk_##_name##_show, mmc_blk_##_name##_store)
+
+static ssize_t mmc_blk_discard_background_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = dev_to_disk(dev)->private_data;
+
+	return sprintf(buf, "%u\n", md->discard_background);
+}
+
+static ssize_t mmc_blk_discard_background_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = dev_to_disk(dev)->private_data;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	/* stop promising zeroes before any discard can be deferred */
+	if (val) {
+		md->queue.queue->limits.discard_zeroes_data = 0;
+		smp_wmb();
+	}
+	md->discard_background = !!val;
+	mmc_blk_update_discard_zeroes(md);
+	wake_up_process(md->queue.thread);
+	return count;
+}
+
+static DEVICE_ATTR(discard_background, S_IRUGO | S_IWUSR,
+		   mmc_blk_discard_background_show,
+		   mmc_blk_discard_background_store);
+
+MMC_BLK_DISCARD_ATTR(discard_idle_ms, discard_idle_ms, val, val);
+MMC_BLK_DISCARD_ATTR(discard_chunk_kb, discard_chunk, val >> 1, val << 1);
+
+static ssize_t mmc_blk_discard_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = dev_to_disk(dev)->private_data;
+	struct mmc_blk_discard_stats *st = &md->discard_stats;
+
+	return sprintf(buf, "pending_ranges %u\npending_kb %u\n"
+		       "queued %lu\nmerged %lu\nsync %lu\n"
+		       "issued %lu\nissued_kb %llu\ncancelled_kb %llu\n"
+		       "errors %lu\n",
+		       md->discard_ranges, md->discard_pending >> 1,
+		       st->queued, st->merged, st->sync,
+		       st->issued, st->issued_sectors >> 1,
+		       st->cancelled_sectors >> 1, st->errors);
+}
+static DEVICE_ATTR(discard_stats, S_IRUGO, mmc_blk_discard_stats_show, NULL);
+
+static struct attribute *mmc_blk_discard_attrs[] = {
+	&dev_attr_discard_background.attr,
+	&dev_attr_discard_idle_ms.attr,
+	&dev_attr_discard_chunk_kb.attr,
+	&dev_attr_discard_stats.attr,
+	NULL,
+};
+
+static struct attribute_group mmc_blk_discard_attr_group = {
+	.attrs = mmc_blk_discard_attrs,
+};
+
+/*
+ * Per request statistics and packing knobs, in the card's debugfs
+ * directory.  Writing to rw_stats clears it.
+ */
+static int mmc_blk_rw_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_blk_data *md = s->private;
+	struct mmc_blk_rw_stats *st = &md->rw_stats;
+	int i;
+
+	seq_printf(s, "reads %lu\nwrites %lu\nrel_writes %lu\nflushes %lu\n",
+		   st->reads, st->writes, st->rel_writes, st->flushes);
+	seq_printf(s, "packs %lu\npacked_reqs %lu\npacked_kb %llu\n"
+		   "packed_errors %lu\n", st->packs, st->packed_reqs,
+		   st->packed_sectors >> 1, st->packed_errors);
+	for (i = 0; i < MMC_BLK_PACKED_STOP_NR; i++)
+		seq_printf(s, "stop_%s %lu\n", mmc_blk_packed_stop_names[i],
+			   st->stop[i]);
+	for (i = 2; i <= MMC_BLK_PACKED_MAX_ENTRIES; i++)
+		if (st->entries[i])
+			seq_printf(s, "entries_%d %lu\n", i, st->entries[i]);
+
+	return 0;
+}
+
+static int mmc_blk_rw_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_blk_rw_stats_show, inode->i_private);
+}
+
+static ssize_t mmc_blk_rw_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct mmc_blk_data *md =
+		((struct seq_file *)file->private_data)->private;
+
+	memset(&md->rw_stats, 0, sizeof(md->rw_stats));
+
+	return count;
+}
+
+static const struct file_operations mmc_blk_rw_stats_fops = {
+	.open		= mmc_blk_rw_stats_open,
+	.read		= seq_read,
+	.write		= mmc_blk_rw_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mmc_blk_add_debugfs(struct mmc_blk_data *md,
+				struct mmc_card *card)
+{
+	struct dentry *root;
+
+	if (!card->debugfs_root)
+		return;
+
+	root = debugfs_create_dir(md->disk->disk_name, card->debugfs_root);
+	if (IS_ERR(root) || !root)
+		goto err_out;
+	md->debugfs_root = root;
+
+	if (!debugfs_create_file("rw_stats", S_IRUSR | S_IWUSR, root, md,
+				 &mmc_blk_rw_stats_fops))
+		goto err_node;
+	if (!debugfs_create_u32("packed_max_entries", S_IRUSR | S_IWUSR,
+				root, &md->packed_max_entries))
+		goto err_node;
+	if (!debugfs_create_u32("packed_max_sectors", S_IRUSR | S_IWUSR,
+				root, &md->packed_max_sectors))
+		goto err_node;
+
+	return;
+
+err_node:
+	debugfs_remove_recursive(root);
+	md->debugfs_root = NULL;
+err_out:
+	printk(KERN_WARNING "%s: failed to initialize debugfs\n",
+	       md->disk->disk_name);
+}
+
 static int mmc_blk_probe(struct mmc_card *card)
 {
 	struct mmc_blk_data *md;
@@ -709,6 +1577,14 @@ static int mmc_blk_probe(struct mmc_card *card)
 
 	mmc_set_drvdata(card, md);
 	add_disk(md->disk);
+
+	mmc_blk_add_debugfs(md, card);
+
+	if (mmc_can_erase(card) &&
+	    sysfs_create_group(&disk_to_dev(md->disk)->kobj,
+			       &mmc_blk_discard_attr_group))
+		printk(KERN_WARNING "%s: no discard sysfs attributes\n",
+		       md->disk->disk_name);
 	return 0;
 
  out:
@@ -723,9 +1599,20 @@ static void mmc_blk_remove(struct mmc_card *card)
 	struct mmc_blk_data *md = mmc_get_drvdata(card);
 
 	if (md) {
+		debugfs_remove_recursive(md->debugfs_root);
+
+		if (mmc_can_erase(card))
+			sysfs_remove_group(&disk_to_dev(md->disk)->kobj,
+					   &mmc_blk_discard_attr_group);
+
 		/* Stop new requests from getting into the queue */
 		del_gendisk(md->disk);
 
+		/* Erase what was deferred, and defer nothing from now on */
+		md->discard_background = 0;
+		mmc_queue_suspend(&md->queue);
+		mmc_blk_discard_flush(md);
+
 		/* Then flush out any already in there */
 		mmc_cleanup_queue(&md->queue);
 
@@ -741,6 +1628,7 @@ static int mmc_blk_suspend(struct mmc_card *card, pm_message_t state)
 
 	if (md) {
 		mmc_queue_suspend(&md->queue);
+		mmc_blk_discard_flush(md);
 	}
 	return 0;
 }
@@ -760,12 +1648,23 @@ static int mmc_blk_resume(struct mmc_card *card)
 #define mmc_blk_resume	NULL
 #endif
 
+static void mmc_blk_shutdown(struct mmc_card *card)
+{
+	struct mmc_blk_data *md = mmc_get_drvdata(card);
+
+	if (md) {
+		mmc_queue_suspend(&md->queue);
+		mmc_blk_discard_flush(md);
+	}
+}
+
 static struct mmc_driver mmc_driver = {
 	.drv		= {
 		.name	= "mmcblk",
 	},
 	.probe		= mmc_blk_probe,
 	.remove		= mmc_blk_remove,
+	.shutdown	= mmc_blk_shutdown,
 	.suspend	= mmc_blk_suspend,
 	.resume		= mmc_blk_resume,
 };
@@ -52,6 +52,7 @@ static int mmc_queue_thread(void *d)
 	down(&mq->thread_sem);
 	do {
 		struct request *req = NULL;
+		long timeout = MAX_SCHEDULE_TIMEOUT;
 
 		spin_lock_irq(q->queue_lock);
 		set_current_state(TASK_INTERRUPTIBLE);
@@ -65,8 +66,21 @@ static int mmc_queue_thread(void *d)
 				set_current_state(TASK_RUNNING);
 				break;
 			}
+			/*
+			 * Nothing queued: give the block driver a chance to
+			 * run deferred work once it has been idle long enough.
+			 * idle_due() must not sleep, we're already marked
+			 * as going to.
+			 */
+			if (mq->idle_due)
+				timeout = mq->idle_due(mq);
+			if (!timeout) {
+				set_current_state(TASK_RUNNING);
+				mq->idle_fn(mq);
+				continue;
+			}
 			up(&mq->thread_sem);
-			schedule();
+			schedule_timeout(timeout);
 			down(&mq->thread_sem);
 			continue;
 		}
@@ -129,6 +143,9 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
+	/* writes are cheapest when they fill whole allocation units */
+	if (card->pref_erase)
+		blk_queue_io_opt(mq->queue, card->pref_erase << 9);
 	if (mmc_can_erase(card)) {
 		queue_flag_set_unlocked(QUEUE_FLAG_DISCARD, mq->queue);
 		mq->queue->limits.max_discard_sectors = UINT_MAX;
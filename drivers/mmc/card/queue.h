@@ -11,6 +11,8 @@ struct mmc_queue {
 	unsigned int		flags;
 	struct request		*req;
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
+	long			(*idle_due)(struct mmc_queue *);
+	void			(*idle_fn)(struct mmc_queue *);
 	void			*data;
 	struct request_queue	*queue;
 	struct scatterlist	*sg;
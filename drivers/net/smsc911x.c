@@ -95,6 +95,10 @@ struct smsc911x_data {
 	/* spinlock to ensure register accesses are serialised */
 	spinlock_t dev_lock;
 
+	/* serialises draining of the tx status fifo, which also reports
+	 * completed bytes to the byte queue limits */
+	spinlock_t tx_stat_lock;
+
 	struct phy_device *phy_dev;
 	struct mii_bus *mii_bus;
 	int phy_irq[PHY_MAX_ADDR];
@@ -910,7 +914,10 @@ static void smsc911x_tx_update_txcounters(struct net_device *dev)
 {
 	struct smsc911x_data *pdata = netdev_priv(dev);
 	unsigned int tx_stat;
+	unsigned int pkts = 0, bytes = 0;
+	unsigned long flags;
 
+	spin_lock_irqsave(&pdata->tx_stat_lock, flags);
 	while ((tx_stat = smsc911x_tx_get_txstatus(pdata)) != 0) {
 		if (unlikely(tx_stat & 0x80000000)) {
 			/* In this driver the packet tag is used as the packet
@@ -923,6 +930,8 @@ static void smsc911x_tx_update_txcounters(struct net_device *dev)
 			SMSC_WARNING(HW,
 				"Packet tag reserved bit is high");
 		} else {
+			pkts++;
+			bytes += (tx_stat >> 16);
 			if (unlikely(tx_stat & TX_STS_ES_)) {
 				dev->stats.tx_errors++;
 			} else {
@@ -944,6 +953,8 @@ static void smsc911x_tx_update_txcounters(struct net_device *dev)
 			}
 		}
 	}
+	netdev_completed_queue(dev, pkts, bytes);
+	spin_unlock_irqrestore(&pdata->tx_stat_lock, flags);
 }
 
 /* Increments the Rx error counters */
@@ -1274,9 +1285,11 @@ static int smsc911x_open(struct net_device *dev)
 	temp |= HW_CFG_SF_;
 	smsc911x_reg_write(pdata, HW_CFG, temp);
 
+	/* Interrupt on every tx status so that completed bytes reach the
+	 * byte queue limits promptly */
 	temp = smsc911x_reg_read(pdata, FIFO_INT);
 	temp |= FIFO_INT_TX_AVAIL_LEVEL_;
-	temp &= ~(FIFO_INT_RX_STS_LEVEL_);
+	temp &= ~(FIFO_INT_RX_STS_LEVEL_ | FIFO_INT_TX_STS_LEVEL_);
 	smsc911x_reg_write(pdata, FIFO_INT, temp);
 
 	/* set RX Data offset to 2 bytes for alignment */
@@ -1286,7 +1299,8 @@ static int smsc911x_open(struct net_device *dev)
 	napi_enable(&pdata->napi);
 
 	temp = smsc911x_reg_read(pdata, INT_EN);
-	temp |= (INT_EN_TDFA_EN_ | INT_EN_RSFL_EN_ | INT_EN_RXSTOP_INT_EN_);
+	temp |= (INT_EN_TDFA_EN_ | INT_EN_TSFL_EN_ | INT_EN_RSFL_EN_ |
+		 INT_EN_RXSTOP_INT_EN_);
 	smsc911x_reg_write(pdata, INT_EN, temp);
 
 	spin_lock_irq(&pdata->mac_lock);
@@ -1297,6 +1311,7 @@ static int smsc911x_open(struct net_device *dev)
 
 	smsc911x_reg_write(pdata, TX_CFG, TX_CFG_TX_ON_);
 
+	netdev_reset_queue(dev);
 	netif_start_queue(dev);
 	return 0;
 }
@@ -1353,6 +1368,9 @@ static int smsc911x_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	tx_cmd_b = ((unsigned int)skb->len) << 16;
 	tx_cmd_b |= (unsigned int)skb->len;
 
+	/* Account the packet before the hardware can report it completed */
+	netdev_sent_queue(dev, skb->len);
+
 	smsc911x_reg_write(pdata, TX_DATA_FIFO, tx_cmd_a);
 	smsc911x_reg_write(pdata, TX_DATA_FIFO, tx_cmd_b);
 
@@ -1501,6 +1519,12 @@ static irqreturn_t smsc911x_irqhandler(int irq, void *dev_id)
 		serviced = IRQ_HANDLED;
 	}
 
+	if (intsts & inten & INT_STS_TSFL_) {
+		smsc911x_reg_write(pdata, INT_STS, INT_STS_TSFL_);
+		smsc911x_tx_update_txcounters(dev);
+		serviced = IRQ_HANDLED;
+	}
+
 	if (unlikely(intsts & inten & INT_STS_RXE_)) {
 		SMSC_TRACE(INTR, "RX Error interrupt");
 		smsc911x_reg_write(pdata, INT_STS, INT_STS_RXE_);
@@ -1831,6 +1855,7 @@ static int __devinit smsc911x_init(struct net_device *dev)
 
 	spin_lock_init(&pdata->dev_lock);
 	spin_lock_init(&pdata->mac_lock);
+	spin_lock_init(&pdata->tx_stat_lock);
 
 	if (pdata->ioaddr == 0) {
 		SMSC_WARNING(PROBE, "pdata->ioaddr: 0x00000000");
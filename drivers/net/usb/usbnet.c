@@ -669,6 +669,11 @@ int usbnet_stop (struct net_device *net)
 	dev->flags = 0;
 	del_timer_sync (&dev->delay);
 	tasklet_kill (&dev->bh);
+
+	/* the urbs are gone and the bh can't complete any more of them;
+	 * don't let their bytes count as in flight on the next open */
+	netdev_reset_queue (net);
+
 	if (info->manage_power)
 		info->manage_power(dev, 0);
 	else
@@ -727,6 +732,7 @@ int usbnet_open (struct net_device *net)
 		}
 	}
 
+	netdev_reset_queue (net);
 	netif_start_queue (net);
 	netif_info(dev, ifup, dev->net,
 		   "open: enable queueing (rx %d, tx %d) mtu %d %s framing\n",
@@ -1113,6 +1119,9 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	case 0:
 		net->trans_start = jiffies;
 		__skb_queue_tail (&dev->txq, skb);
+		/* still under txq.lock, so tx_complete() can't defer this
+		 * skb before its bytes are accounted */
+		netdev_sent_queue (net, length);
 		if (dev->txq.qlen >= TX_QLEN (dev))
 			netif_stop_queue (net);
 	}
@@ -1144,6 +1153,8 @@ static void usbnet_bh (unsigned long param)
 	struct usbnet		*dev = (struct usbnet *) param;
 	struct sk_buff		*skb;
 	struct skb_data		*entry;
+	unsigned int		tx_pkts = 0, tx_bytes = 0;
+	unsigned long		flags;
 
 	while ((skb = skb_dequeue (&dev->done))) {
 		entry = (struct skb_data *) skb->cb;
@@ -1153,6 +1164,9 @@ static void usbnet_bh (unsigned long param)
 			rx_process (dev, skb);
 			continue;
 		case tx_done:
+			tx_pkts++;
+			tx_bytes += entry->length;
+			/* FALLTHROUGH */
 		case rx_cleanup:
 			usb_free_urb (entry->urb);
 			dev_kfree_skb (skb);
@@ -1162,6 +1176,14 @@ static void usbnet_bh (unsigned long param)
 		}
 	}
 
+	/* the bh runs from both the tasklet and the delay timer; txq.lock
+	 * keeps byte queue limit completions serialised */
+	if (tx_pkts) {
+		spin_lock_irqsave (&dev->txq.lock, flags);
+		netdev_completed_queue (dev->net, tx_pkts, tx_bytes);
+		spin_unlock_irqrestore (&dev->txq.lock, flags);
+	}
+
 	// waiting for all pending urbs to complete?
 	if (dev->wait) {
 		if ((dev->txq.qlen + dev->rxq.qlen + dev->done.qlen) == 0) {
@@ -1485,8 +1507,11 @@ int usbnet_resume (struct usb_interface *intf)
 				usb_free_urb(res);
 				usb_autopm_put_interface_async(dev->intf);
 			} else {
+				struct skb_data *entry = (struct skb_data *)skb->cb;
+
 				dev->net->trans_start = jiffies;
 				__skb_queue_tail(&dev->txq, skb);
+				netdev_sent_queue(dev->net, entry->length);
 			}
 		}
 
@@ -45,6 +45,10 @@ static struct uart_omap_port *ui[OMAP_MAX_HSUART_PORTS];
 static void uart_tx_dma_callback(int lch, u16 ch_status, void *data);
 static void serial_omap_rx_timeout(unsigned long uart_no);
 static int serial_omap_start_rxdma(struct uart_omap_port *up);
+static void serial_omap_rx_dma_flush(struct uart_omap_port *up);
+static void serial_omap_rx_dma_drain(struct uart_omap_port *up,
+				     unsigned int *lsr);
+static void serial_omap_continue_tx(struct uart_omap_port *up);
 
 static inline unsigned int serial_in(struct uart_omap_port *up, int offset)
 {
@@ -93,12 +97,18 @@ serial_omap_get_divisor(struct uart_port *port, unsigned int baud)
 
 static void serial_omap_stop_rxdma(struct uart_omap_port *up)
 {
+	unsigned long flags;
+
 	if (up->uart_dma.rx_dma_used) {
 		del_timer(&up->uart_dma.rx_timer);
+		spin_lock_irqsave(&up->uart_dma.rx_lock, flags);
+		up->uart_dma.rx_dma_used = false;
+		spin_unlock_irqrestore(&up->uart_dma.rx_lock, flags);
 		omap_stop_dma(up->uart_dma.rx_dma_channel);
+		omap_dma_unlink_lch(up->uart_dma.rx_dma_channel,
+				    up->uart_dma.rx_dma_channel);
 		omap_free_dma(up->uart_dma.rx_dma_channel);
 		up->uart_dma.rx_dma_channel = OMAP_UART_DMA_CH_FREE;
-		up->uart_dma.rx_dma_used = false;
 	}
 }
 
@@ -295,8 +305,6 @@ static void transmit_chars(struct uart_omap_port *up)
 static void serial_omap_start_tx(struct uart_port *port)
 {
 	struct uart_omap_port *up = (struct uart_omap_port *)port;
-	struct circ_buf *xmit;
-	unsigned int start;
 	int ret = 0;
 
 	if (up->rs485.flags & SER_RS485_ENABLED) {
@@ -320,8 +328,6 @@ static void serial_omap_start_tx(struct uart_port *port)
 	if (up->uart_dma.tx_dma_used)
 		return;
 
-	xmit = &up->port.state->xmit;
-
 	if (up->uart_dma.tx_dma_channel == OMAP_UART_DMA_CH_FREE) {
 		ret = omap_request_dma(up->uart_dma.uart_dma_tx,
 				       "UART Tx DMA",
@@ -332,38 +338,17 @@ static void serial_omap_start_tx(struct uart_port *port)
 			serial_omap_enable_ier_thri(up);
 			return;
 		}
+
+		/* Only the source and length change from chunk to chunk */
+		omap_set_dma_dest_params(up->uart_dma.tx_dma_channel, 0,
+					 OMAP_DMA_AMODE_CONSTANT,
+					 up->uart_dma.uart_base, 0, 0);
 	}
 	spin_lock(&(up->uart_dma.tx_lock));
 	up->uart_dma.tx_dma_used = true;
 	spin_unlock(&(up->uart_dma.tx_lock));
 
-	start = up->uart_dma.tx_buf_dma_phys +
-		(xmit->tail & (UART_XMIT_SIZE - 1));
-
-	up->uart_dma.tx_buf_size = uart_circ_chars_pending(xmit);
-	/*
-	 * It is a circular buffer. See if the buffer has wounded back.
-	 * If yes it will have to be transferred in two separate dma
-	 * transfers
-	 */
-	if (start + up->uart_dma.tx_buf_size >=
-	    up->uart_dma.tx_buf_dma_phys + UART_XMIT_SIZE)
-		up->uart_dma.tx_buf_size =
-			(up->uart_dma.tx_buf_dma_phys +
-			 UART_XMIT_SIZE) - start;
-
-	omap_set_dma_dest_params(up->uart_dma.tx_dma_channel, 0,
-				 OMAP_DMA_AMODE_CONSTANT,
-				 up->uart_dma.uart_base, 0, 0);
-	omap_set_dma_src_params(up->uart_dma.tx_dma_channel, 0,
-				OMAP_DMA_AMODE_POST_INC, start, 0, 0);
-	omap_set_dma_transfer_params(up->uart_dma.tx_dma_channel,
-				     OMAP_DMA_DATA_TYPE_S8,
-				     up->uart_dma.tx_buf_size, 1,
-				     OMAP_DMA_SYNC_ELEMENT,
-				     up->uart_dma.uart_dma_tx, 0);
-	/* FIXME: Cache maintenance needed here? */
-	omap_start_dma(up->uart_dma.tx_dma_channel);
+	serial_omap_continue_tx(up);
 }
 
 static unsigned int check_modem_status(struct uart_omap_port *up)
@@ -430,15 +415,26 @@ static inline irqreturn_t serial_omap_irq(int irq, void *dev_id)
 	}
 	lsr = serial_in(up, UART_LSR);
 	if (iir & UART_IIR_RLSI) {
-		if (!up->use_dma) {
+		if (!up->uart_dma.rx_dma_used) {
 			if (lsr & UART_LSR_DR)
 				receive_chars(up, &lsr);
+		} else if ((iir & OMAP_UART_IIR_ID) ==
+			   OMAP_UART_IIR_RX_TIMEOUT) {
+			/*
+			 * Line went quiet with less than a DMA burst left
+			 * in the FIFO: push the ring, then the leftovers.
+			 */
+			serial_omap_rx_dma_drain(up, &lsr);
 		} else {
+			/*
+			 * Data is streaming into the ring.  Stop taking an
+			 * interrupt per DMA burst and flush from the timer
+			 * until the line goes quiet again.
+			 */
 			up->ier &= ~(UART_IER_RDI | UART_IER_RLSI);
 			serial_out(up, UART_IER, up->ier);
-			if ((serial_omap_start_rxdma(up) != 0) &&
-					(lsr & UART_LSR_DR))
-				receive_chars(up, &lsr);
+			mod_timer(&up->uart_dma.rx_timer, jiffies +
+				usecs_to_jiffies(up->uart_dma.rx_timeout));
 		}
 	}
 
@@ -580,10 +576,12 @@ static int serial_omap_startup(struct uart_port *port)
 		init_timer(&(up->uart_dma.rx_timer));
 		up->uart_dma.rx_timer.function = serial_omap_rx_timeout;
 		up->uart_dma.rx_timer.data = up->pdev->id;
-		/* Currently the buffer size is 4KB. Can increase it */
 		up->uart_dma.rx_buf = dma_alloc_coherent(NULL,
 			up->uart_dma.rx_buf_size,
 			(dma_addr_t *)&(up->uart_dma.rx_buf_dma_phys), 0);
+		/* Without the ring we simply stay in interrupt mode */
+		if (up->uart_dma.rx_buf)
+			serial_omap_start_rxdma(up);
 	}
 	/*
 	 * Finally, enable interrupts. Note: Modem status interrupts
@@ -821,9 +819,12 @@ serial_omap_set_termios(struct uart_port *port, struct ktermios *termios,
 	serial_out(up, UART_LCR, UART_LCR_CONF_MODE_B);
 
 	if (up->use_dma) {
-		serial_out(up, UART_TI752_TLR, 0);
-		serial_out(up, UART_OMAP_SCR,
-			(UART_FCR_TRIGGER_4 | UART_FCR_TRIGGER_8));
+		/*
+		 * RX: DMA in bursts of OMAP_UART_DMA_RX_TLR bytes, so that
+		 * a trailing partial burst raises the RX timeout interrupt.
+		 */
+		serial_out(up, UART_TI752_TLR, OMAP_UART_DMA_RX_TLR);
+		serial_out(up, UART_OMAP_SCR, UART_FCR_TRIGGER_4);
 	}
 
 	serial_out(up, UART_EFR, up->efr);
@@ -1164,62 +1165,126 @@ static int serial_omap_resume(struct platform_device *dev)
 	return 0;
 }
 
-static void serial_omap_rx_timeout(unsigned long uart_no)
+/*
+ * Push whatever the RX ring has received since the last flush up to
+ * the tty.  Called from the DMA frame callback at every half ring, from
+ * the flush timer while data streams in, and from the RX timeout IRQ.
+ */
+static void serial_omap_rx_dma_flush(struct uart_omap_port *up)
 {
-	struct uart_omap_port *up = ui[uart_no];
-	unsigned int curr_dma_pos, curr_transmitted_size;
-	int ret = 0;
+	struct uart_omap_dma *dma = &up->uart_dma;
+	struct tty_struct *tty = up->port.state->port.tty;
+	unsigned int head, tail, count = 0;
+	unsigned long flags;
+	dma_addr_t pos;
 
-	curr_dma_pos = omap_get_dma_dst_pos(up->uart_dma.rx_dma_channel);
-	if ((curr_dma_pos == up->uart_dma.prev_rx_dma_pos) ||
-			     (curr_dma_pos == 0)) {
-		if (jiffies_to_msecs(jiffies - up->port_activity) <
-							RX_TIMEOUT) {
-			mod_timer(&up->uart_dma.rx_timer, jiffies +
-				usecs_to_jiffies(up->uart_dma.rx_timeout));
-		} else {
-			serial_omap_stop_rxdma(up);
-			up->ier |= (UART_IER_RDI | UART_IER_RLSI);
-			serial_out(up, UART_IER, up->ier);
-		}
+	if (!tty)
+		return;
+
+	spin_lock_irqsave(&dma->rx_lock, flags);
+	if (!dma->rx_dma_used) {
+		spin_unlock_irqrestore(&dma->rx_lock, flags);
 		return;
 	}
 
-	curr_transmitted_size = curr_dma_pos -
-					up->uart_dma.prev_rx_dma_pos;
-	up->port.icount.rx += curr_transmitted_size;
-	tty_insert_flip_string(up->port.state->port.tty,
-			up->uart_dma.rx_buf +
-			(up->uart_dma.prev_rx_dma_pos -
-			up->uart_dma.rx_buf_dma_phys),
-			curr_transmitted_size);
-	tty_flip_buffer_push(up->port.state->port.tty);
-	up->uart_dma.prev_rx_dma_pos = curr_dma_pos;
-	if (up->uart_dma.rx_buf_size +
-			up->uart_dma.rx_buf_dma_phys == curr_dma_pos) {
-		ret = serial_omap_start_rxdma(up);
-		if (ret < 0) {
-			serial_omap_stop_rxdma(up);
-			up->ier |= (UART_IER_RDI | UART_IER_RLSI);
-			serial_out(up, UART_IER, up->ier);
-		}
-	} else  {
+	pos = omap_get_dma_dst_pos(dma->rx_dma_channel);
+	if (pos < dma->rx_buf_dma_phys ||
+	    pos > dma->rx_buf_dma_phys + dma->rx_buf_size) {
+		/* Nothing transferred into this lap yet */
+		spin_unlock_irqrestore(&dma->rx_lock, flags);
+		return;
+	}
+
+	head = (pos - dma->rx_buf_dma_phys) % dma->rx_buf_size;
+	tail = dma->rx_tail;
+
+	if (head < tail) {
+		count += tty_insert_flip_string(tty, dma->rx_buf + tail,
+						dma->rx_buf_size - tail);
+		tail = 0;
+	}
+	if (head > tail)
+		count += tty_insert_flip_string(tty, dma->rx_buf + tail,
+						head - tail);
+	dma->rx_tail = head;
+
+	spin_unlock_irqrestore(&dma->rx_lock, flags);
+
+	if (count) {
+		up->port.icount.rx += count;
+		tty_flip_buffer_push(tty);
+		up->port_activity = jiffies;
+	}
+}
+
+/*
+ * RX timeout with the ring running: the channel may still be moving a
+ * burst out of the FIFO, so stop it before reading the FIFO with PIO or
+ * the leftovers could overtake bytes that are in flight.  Everything the
+ * channel wrote goes up first, then the FIFO, then the ring restarts at
+ * its beginning.  Called with the port lock held.
+ */
+static void serial_omap_rx_dma_drain(struct uart_omap_port *up,
+				     unsigned int *lsr)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+
+	omap_stop_dma(dma->rx_dma_channel);
+	serial_omap_rx_dma_flush(up);
+
+	/* keep the error bits, they are cleared by the read */
+	*lsr = (*lsr & UART_LSR_BRK_ERROR_BITS) | serial_in(up, UART_LSR);
+	if (*lsr & UART_LSR_DR)
+		receive_chars(up, lsr);
+
+	spin_lock(&dma->rx_lock);
+	if (dma->rx_dma_used) {
+		dma->rx_tail = 0;
+		omap_start_dma(dma->rx_dma_channel);
+	}
+	spin_unlock(&dma->rx_lock);
+}
+
+static void serial_omap_rx_timeout(unsigned long uart_no)
+{
+	struct uart_omap_port *up = ui[uart_no];
+	unsigned int tail = up->uart_dma.rx_tail;
+	unsigned long flags;
+
+	serial_omap_rx_dma_flush(up);
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (!up->uart_dma.rx_dma_used) {
+		/* raced with stop_rx */
+	} else if (up->uart_dma.rx_tail != tail) {
 		mod_timer(&up->uart_dma.rx_timer, jiffies +
 			usecs_to_jiffies(up->uart_dma.rx_timeout));
+	} else {
+		/*
+		 * Quiet for a whole period: hand back to the UART, which
+		 * interrupts on the next burst or on an RX timeout.
+		 */
+		up->ier |= (UART_IER_RDI | UART_IER_RLSI);
+		serial_out(up, UART_IER, up->ier);
 	}
-	up->port_activity = jiffies;
+	spin_unlock_irqrestore(&up->port.lock, flags);
 }
 
 static void uart_rx_dma_callback(int lch, u16 ch_status, void *data)
 {
-	return;
+	serial_omap_rx_dma_flush(data);
 }
 
+/*
+ * Start the RX ring: two frames of half the buffer each, with the
+ * channel linked to itself so the DMA wraps around without being
+ * reprogrammed and never stops while the port is open.
+ */
 static int serial_omap_start_rxdma(struct uart_omap_port *up)
 {
 	int ret = 0;
 
-	if (up->uart_dma.rx_dma_channel == -1) {
+	if (up->uart_dma.rx_dma_channel == OMAP_UART_DMA_CH_FREE) {
 		ret = omap_request_dma(up->uart_dma.uart_dma_rx,
 				"UART Rx DMA",
 				(void *)uart_rx_dma_callback, up,
@@ -1235,41 +1300,37 @@ static int serial_omap_start_rxdma(struct uart_omap_port *up)
 				up->uart_dma.rx_buf_dma_phys, 0, 0);
 		omap_set_dma_transfer_params(up->uart_dma.rx_dma_channel,
 				OMAP_DMA_DATA_TYPE_S8,
-				up->uart_dma.rx_buf_size, 1,
+				up->uart_dma.rx_buf_size / 2, 2,
 				OMAP_DMA_SYNC_ELEMENT,
 				up->uart_dma.uart_dma_rx, 0);
+		omap_enable_dma_irq(up->uart_dma.rx_dma_channel,
+				OMAP_DMA_FRAME_IRQ);
+		omap_dma_link_lch(up->uart_dma.rx_dma_channel,
+				up->uart_dma.rx_dma_channel);
 	}
-	up->uart_dma.prev_rx_dma_pos = up->uart_dma.rx_buf_dma_phys;
-	/* FIXME: Cache maintenance needed here? */
+	up->uart_dma.rx_tail = 0;
+	/* The ring is coherent memory, no cache maintenance needed */
 	omap_start_dma(up->uart_dma.rx_dma_channel);
-	mod_timer(&up->uart_dma.rx_timer, jiffies +
-				usecs_to_jiffies(up->uart_dma.rx_timeout));
 	up->uart_dma.rx_dma_used = true;
 	return ret;
 }
 
+/*
+ * Send everything between tail and head straight out of the circ
+ * buffer (it is coherent memory).  When the data wraps, the part up to
+ * the end of the buffer goes first and the callback carries on from
+ * the start, along with anything queued meanwhile.
+ */
 static void serial_omap_continue_tx(struct uart_omap_port *up)
 {
 	struct circ_buf *xmit = &up->port.state->xmit;
-	unsigned int start = up->uart_dma.tx_buf_dma_phys
-			+ (xmit->tail & (UART_XMIT_SIZE - 1));
+	unsigned int start = up->uart_dma.tx_buf_dma_phys + xmit->tail;
 
 	if (uart_circ_empty(xmit))
 		return;
 
-	up->uart_dma.tx_buf_size = uart_circ_chars_pending(xmit);
-	/*
-	 * It is a circular buffer. See if the buffer has wounded back.
-	 * If yes it will have to be transferred in two separate dma
-	 * transfers
-	 */
-	if (start + up->uart_dma.tx_buf_size >=
-			up->uart_dma.tx_buf_dma_phys + UART_XMIT_SIZE)
-		up->uart_dma.tx_buf_size =
-			(up->uart_dma.tx_buf_dma_phys + UART_XMIT_SIZE) - start;
-	omap_set_dma_dest_params(up->uart_dma.tx_dma_channel, 0,
-				OMAP_DMA_AMODE_CONSTANT,
-				up->uart_dma.uart_base, 0, 0);
+	up->uart_dma.tx_buf_size = CIRC_CNT_TO_END(xmit->head, xmit->tail,
+						   UART_XMIT_SIZE);
 	omap_set_dma_src_params(up->uart_dma.tx_dma_channel, 0,
 				OMAP_DMA_AMODE_POST_INC, start, 0, 0);
 	omap_set_dma_transfer_params(up->uart_dma.tx_dma_channel,
@@ -1277,7 +1338,6 @@ static void serial_omap_continue_tx(struct uart_omap_port *up)
 				up->uart_dma.tx_buf_size, 1,
 				OMAP_DMA_SYNC_ELEMENT,
 				up->uart_dma.uart_dma_tx, 0);
-	/* FIXME: Cache maintenance needed here? */
 	omap_start_dma(up->uart_dma.tx_dma_channel);
 }
 
@@ -1285,6 +1345,9 @@ static void uart_tx_dma_callback(int lch, u16 ch_status, void *data)
 {
 	struct uart_omap_port *up = (struct uart_omap_port *)data;
 	struct circ_buf *xmit = &up->port.state->xmit;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
 
 	xmit->tail = (xmit->tail + up->uart_dma.tx_buf_size) & \
 			(UART_XMIT_SIZE - 1);
@@ -1303,7 +1366,8 @@ static void uart_tx_dma_callback(int lch, u16 ch_status, void *data)
 		serial_omap_continue_tx(up);
 	}
 	up->port_activity = jiffies;
-	return;
+
+	spin_unlock_irqrestore(&up->port.lock, flags);
 }
 
 static int serial_omap_probe(struct platform_device *pdev)
@@ -1371,8 +1435,13 @@ static int serial_omap_probe(struct platform_device *pdev)
 		up->uart_dma.uart_dma_tx = dma_tx->start;
 		up->uart_dma.uart_dma_rx = dma_rx->start;
 		up->use_dma = 1;
-		up->uart_dma.rx_buf_size = 4096;
-		up->uart_dma.rx_timeout = 2;
+		/* Ring is used as two frames of half its size */
+		up->uart_dma.rx_buf_size = omap_up_info->dma_rx_buf_size ?
+			ALIGN(omap_up_info->dma_rx_buf_size, 2) :
+			OMAP_UART_DMA_RX_BUF_SIZE;
+		up->uart_dma.rx_timeout = omap_up_info->dma_rx_timeout ?
+			omap_up_info->dma_rx_timeout :
+			OMAP_UART_DMA_RX_TIMEOUT;
 		spin_lock_init(&(up->uart_dma.tx_lock));
 		spin_lock_init(&(up->uart_dma.rx_lock));
 		up->uart_dma.tx_dma_channel = OMAP_UART_DMA_CH_FREE;
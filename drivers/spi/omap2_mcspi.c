@@ -33,6 +33,8 @@
 #include <linux/clk.h>
 #include <linux/io.h>
 #include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
 
 #include <linux/spi/spi.h>
 
@@ -53,6 +55,7 @@
 #define OMAP2_MCSPI_WAKEUPENABLE	0x20
 #define OMAP2_MCSPI_SYST		0x24
 #define OMAP2_MCSPI_MODULCTRL		0x28
+#define OMAP2_MCSPI_XFERLEVEL		0x7c
 
 /* per-channel banks, 0x14 bytes each, first is: */
 #define OMAP2_MCSPI_CHCONF0		0x2c
@@ -89,10 +92,15 @@
 #define OMAP2_MCSPI_CHCONF_IS		BIT(18)
 #define OMAP2_MCSPI_CHCONF_TURBO	BIT(19)
 #define OMAP2_MCSPI_CHCONF_FORCE	BIT(20)
+#define OMAP2_MCSPI_CHCONF_FFEW		BIT(27)
+#define OMAP2_MCSPI_CHCONF_FFER		BIT(28)
 
 #define OMAP2_MCSPI_CHSTAT_RXS		BIT(0)
 #define OMAP2_MCSPI_CHSTAT_TXS		BIT(1)
 #define OMAP2_MCSPI_CHSTAT_EOT		BIT(2)
+#define OMAP2_MCSPI_CHSTAT_TXFFE	BIT(3)
+#define OMAP2_MCSPI_CHSTAT_TXFFF	BIT(4)
+#define OMAP2_MCSPI_CHSTAT_RXFFE	BIT(5)
 
 #define OMAP2_MCSPI_CHCTRL_EN		BIT(0)
 
@@ -119,9 +127,21 @@ struct omap2_mcspi_dma {
 #define DMA_MIN_BYTES			160
 #endif
 
+/* OMAP3 and later have a 64 byte FIFO, usable by one channel at a time and
+ * split in two halves when used for both directions.
+ */
+#define OMAP2_MCSPI_FIFO_DEPTH		64
+
+static int rt_priority;
+module_param(rt_priority, int, S_IRUGO);
+MODULE_PARM_DESC(rt_priority,
+	"SCHED_FIFO priority of the message pump threads (0 = not realtime)");
 
 struct omap2_mcspi {
-	struct work_struct	work;
+	/* messages are pumped by a thread of our own */
+	struct kthread_worker	kworker;
+	struct task_struct	*kworker_task;
+	struct kthread_work	work;
 	/* lock protects queue and registers */
 	spinlock_t		lock;
 	struct list_head	msg_queue;
@@ -133,6 +153,8 @@ struct omap2_mcspi {
 	unsigned long		phys;
 	/* SPI1 has 4 channels, while SPI2 has 2 */
 	struct omap2_mcspi_dma	*dma_channels;
+	/* 0 if there is no FIFO */
+	unsigned		fifo_depth;
 };
 
 struct omap2_mcspi_cs {
@@ -156,8 +178,6 @@ struct omap2_mcspi_regs {
 
 static struct omap2_mcspi_regs omap2_mcspi_ctx[OMAP2_MCSPI_MAX_CTRL];
 
-static struct workqueue_struct *omap2_mcspi_wq;
-
 #define MOD_REG_BIT(val, mask, set) do { \
 	if (set) \
 		val |= mask; \
@@ -655,6 +675,128 @@ out:
 	return count - c;
 }
 
+static inline void mcspi_fifo_write(void __iomem *tx_reg, const void *tx,
+		unsigned i, unsigned bytes_per_word)
+{
+	if (bytes_per_word == 1)
+		__raw_writel(((const u8 *)tx)[i], tx_reg);
+	else if (bytes_per_word == 2)
+		__raw_writel(((const u16 *)tx)[i], tx_reg);
+	else
+		__raw_writel(((const u32 *)tx)[i], tx_reg);
+}
+
+static inline void mcspi_fifo_read(void __iomem *rx_reg, void *rx,
+		unsigned i, unsigned bytes_per_word)
+{
+	u32 w = __raw_readl(rx_reg);
+
+	if (bytes_per_word == 1)
+		((u8 *)rx)[i] = w;
+	else if (bytes_per_word == 2)
+		((u16 *)rx)[i] = w;
+	else
+		((u32 *)rx)[i] = w;
+}
+
+static void omap2_mcspi_set_fifo(const struct spi_device *spi, u32 mask)
+{
+	u32 l;
+
+	/* FIFO enables may only change while the channel is disabled */
+	omap2_mcspi_set_enable(spi, 0);
+	l = mcspi_cached_chconf0(spi);
+	l &= ~(OMAP2_MCSPI_CHCONF_FFEW | OMAP2_MCSPI_CHCONF_FFER);
+	l |= mask;
+	mcspi_write_chconf0(spi, l);
+	omap2_mcspi_set_enable(spi, 1);
+}
+
+/*
+ * PIO through the FIFO: words are written until the TX FIFO is full and read
+ * until the RX FIFO is empty, instead of waiting for TXS/RXS on every word.
+ * Used for TX-only and full duplex transfers; RX-only and turbo mode transfers
+ * go through omap2_mcspi_txrx_pio().
+ */
+static unsigned
+omap2_mcspi_txrx_fifo(struct spi_device *spi, struct spi_transfer *xfer)
+{
+	struct omap2_mcspi	*mcspi;
+	struct omap2_mcspi_cs	*cs = spi->controller_state;
+	void __iomem		*base = cs->base;
+	void __iomem		*tx_reg = base + OMAP2_MCSPI_TX0;
+	void __iomem		*rx_reg = base + OMAP2_MCSPI_RX0;
+	void __iomem		*chstat_reg = base + OMAP2_MCSPI_CHSTAT0;
+	const void		*tx = xfer->tx_buf;
+	void			*rx = xfer->rx_buf;
+	unsigned		bytes_per_word, words, fifo_words;
+	unsigned		tx_words = 0, rx_words = 0;
+	unsigned long		timeout;
+	u32			stat;
+
+	mcspi = spi_master_get_devdata(spi->master);
+
+	if (cs->word_len <= 8)
+		bytes_per_word = 1;
+	else if (cs->word_len <= 16)
+		bytes_per_word = 2;
+	else
+		bytes_per_word = 4;
+
+	words = xfer->len / bytes_per_word;
+	if (rx != NULL)
+		fifo_words = mcspi->fifo_depth / 2 / bytes_per_word;
+	else
+		fifo_words = mcspi->fifo_depth / bytes_per_word;
+
+	mcspi_write_reg(spi->master, OMAP2_MCSPI_XFERLEVEL, 0);
+	omap2_mcspi_set_fifo(spi, OMAP2_MCSPI_CHCONF_FFEW |
+			(rx != NULL ? OMAP2_MCSPI_CHCONF_FFER : 0));
+
+	timeout = jiffies + msecs_to_jiffies(1000);
+	while (tx_words < words || (rx != NULL && rx_words < words)) {
+		stat = __raw_readl(chstat_reg);
+
+		/* with RX, keep at most a FIFO worth of words in flight so
+		 * that the RX FIFO can't overflow */
+		while (tx_words < words &&
+				!(stat & OMAP2_MCSPI_CHSTAT_TXFFF) &&
+				(rx == NULL || tx_words - rx_words < fifo_words)) {
+			mcspi_fifo_write(tx_reg, tx, tx_words++,
+					bytes_per_word);
+			stat = __raw_readl(chstat_reg);
+		}
+
+		while (rx != NULL && rx_words < tx_words &&
+				!(stat & OMAP2_MCSPI_CHSTAT_RXFFE)) {
+			mcspi_fifo_read(rx_reg, rx, rx_words++,
+					bytes_per_word);
+			stat = __raw_readl(chstat_reg);
+		}
+
+		if (time_after(jiffies, timeout)) {
+			dev_err(&spi->dev, "FIFO transfer timed out\n");
+			goto out;
+		}
+		cpu_relax();
+	}
+
+	/* for TX_ONLY mode, be sure all words have shifted out */
+	if (rx == NULL) {
+		if (mcspi_wait_for_reg_bit(chstat_reg,
+				OMAP2_MCSPI_CHSTAT_TXFFE) < 0)
+			dev_err(&spi->dev, "TXFFE timed out\n");
+		else if (mcspi_wait_for_reg_bit(chstat_reg,
+				OMAP2_MCSPI_CHSTAT_EOT) < 0)
+			dev_err(&spi->dev, "EOT timed out\n");
+	}
+out:
+	/* disabling the FIFO also purges RX data of TX_ONLY transfers */
+	omap2_mcspi_set_fifo(spi, 0);
+
+	return (rx != NULL ? rx_words : tx_words) * bytes_per_word;
+}
+
 /* called only when no transfer is active to this device */
 static int omap2_mcspi_setup_transfer(struct spi_device *spi,
 		struct spi_transfer *t)
@@ -866,7 +1008,7 @@ static void omap2_mcspi_cleanup(struct spi_device *spi)
 	}
 }
 
-static void omap2_mcspi_work(struct work_struct *work)
+static void omap2_mcspi_work(struct kthread_work *work)
 {
 	struct omap2_mcspi	*mcspi;
 
@@ -950,6 +1092,10 @@ static void omap2_mcspi_work(struct work_struct *work)
 
 				if (m->is_dma_mapped || t->len >= DMA_MIN_BYTES)
 					count = omap2_mcspi_txrx_dma(spi, t);
+				else if (mcspi->fifo_depth && t->tx_buf != NULL
+						&& !(chconf &
+						OMAP2_MCSPI_CHCONF_TURBO))
+					count = omap2_mcspi_txrx_fifo(spi, t);
 				else
 					count = omap2_mcspi_txrx_pio(spi, t);
 				m->actual_length += count;
@@ -1065,7 +1211,7 @@ static int omap2_mcspi_transfer(struct spi_device *spi, struct spi_message *m)
 
 	spin_lock_irqsave(&mcspi->lock, flags);
 	list_add_tail(&m->queue, &mcspi->msg_queue);
-	queue_work(omap2_mcspi_wq, &mcspi->work);
+	queue_kthread_work(&mcspi->kworker, &mcspi->work);
 	spin_unlock_irqrestore(&mcspi->lock, flags);
 
 	return 0;
@@ -1228,7 +1374,8 @@ static int __init omap2_mcspi_probe(struct platform_device *pdev)
 		goto err1aa;
 	}
 
-	INIT_WORK(&mcspi->work, omap2_mcspi_work);
+	init_kthread_worker(&mcspi->kworker);
+	init_kthread_work(&mcspi->work, omap2_mcspi_work);
 
 	spin_lock_init(&mcspi->lock);
 	INIT_LIST_HEAD(&mcspi->msg_queue);
@@ -1261,15 +1408,35 @@ static int __init omap2_mcspi_probe(struct platform_device *pdev)
 		mcspi->dma_channels[i].dma_tx_sync_dev = txdma_id[i];
 	}
 
+	if (cpu_is_omap34xx() || cpu_is_omap44xx())
+		mcspi->fifo_depth = OMAP2_MCSPI_FIFO_DEPTH;
+
 	if (omap2_mcspi_reset(mcspi) < 0)
 		goto err4;
 
+	mcspi->kworker_task = kthread_run(kthread_worker_fn, &mcspi->kworker,
+			"%s", dev_name(&pdev->dev));
+	if (IS_ERR(mcspi->kworker_task)) {
+		status = PTR_ERR(mcspi->kworker_task);
+		goto err4;
+	}
+
+	if (rt_priority > 0) {
+		struct sched_param param = { .sched_priority = rt_priority };
+
+		if (sched_setscheduler(mcspi->kworker_task, SCHED_FIFO,
+					&param))
+			dev_warn(&pdev->dev, "can't set pump priority\n");
+	}
+
 	status = spi_register_master(master);
 	if (status < 0)
-		goto err4;
+		goto err5;
 
 	return status;
 
+err5:
+	kthread_stop(mcspi->kworker_task);
 err4:
 	kfree(mcspi->dma_channels);
 err3:
@@ -1303,6 +1470,9 @@ static int __exit omap2_mcspi_remove(struct platform_device *pdev)
 	r = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	release_mem_region(r->start, (r->end - r->start) + 1);
 
+	flush_kthread_worker(&mcspi->kworker);
+	kthread_stop(mcspi->kworker_task);
+
 	base = mcspi->base;
 	spi_unregister_master(master);
 	iounmap(base);
@@ -1364,10 +1534,6 @@ static struct platform_driver omap2_mcspi_driver = {
 
 static int __init omap2_mcspi_init(void)
 {
-	omap2_mcspi_wq = create_singlethread_workqueue(
-				omap2_mcspi_driver.driver.name);
-	if (omap2_mcspi_wq == NULL)
-		return -1;
 	return platform_driver_probe(&omap2_mcspi_driver, omap2_mcspi_probe);
 }
 subsys_initcall(omap2_mcspi_init);
@@ -1375,8 +1541,6 @@ subsys_initcall(omap2_mcspi_init);
 static void __exit omap2_mcspi_exit(void)
 {
 	platform_driver_unregister(&omap2_mcspi_driver);
-
-	destroy_workqueue(omap2_mcspi_wq);
 }
 module_exit(omap2_mcspi_exit);
 
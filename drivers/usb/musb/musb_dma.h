@@ -110,6 +110,15 @@ struct musb_hw_ep;
 # endif
 #endif
 
+/* Peripheral side RX mode 1, used for short_not_ok requests only; see
+ * rxstate().  Blackfin parts with anomaly 05000456 keep mode 0.
+ */
+#if defined(CONFIG_BLACKFIN) && ANOMALY_05000456
+# define musb_gadget_rx_mode1()		0
+#else
+# define musb_gadget_rx_mode1()		is_inventra_dma_enabled()
+#endif
+
 /*
  * DMA channel status ... updated by the dma controller driver whenever that
  * status changes, and protected by the overall controller spinlock.
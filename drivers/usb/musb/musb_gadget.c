@@ -529,7 +529,9 @@ void musb_g_tx(struct musb *musb, u8 epnum)
 /* ------------------------------------------------------------ */
 
 /* Peripheral rx (OUT) using Mentor DMA works as follows:
-	- Only mode 0 is used.
+	- Mode 0 is used, except for requests flagged short_not_ok: once
+	  a full packet shows up, the rest of such a request is handed to
+	  the engine in mode 1 and completes with one DMA irq.
 
 	- Request is queued by the gadget class driver.
 		-> if queue was previously empty, rxstate()
@@ -628,58 +630,66 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 				c = musb->dma_controller;
 				channel = musb_ep->dma;
 
-	/* We use DMA Req mode 0 in rx_csr, and DMA controller operates in
-	 * mode 0 only. So we do not get endpoint interrupts due to DMA
-	 * completion. We only get interrupts from DMA controller.
+	/* Mode 0 costs a DMA irq plus an endpoint irq per packet.  Mode 1
+	 * lets the engine drain back-to-back full packets on its own with
+	 * AUTOCLEAR acking each one, and only interrupts once the whole
+	 * request has been moved.
 	 *
-	 * We could operate in DMA mode 1 if we knew the size of the tranfer
-	 * in advance. For mass storage class, request->length = what the host
-	 * sends, so that'd work.  But for pretty much everything else,
-	 * request->length is routinely more than what the host sends. For
-	 * most these gadgets, end of is signified either by a short packet,
-	 * or filling the last byte of the buffer.  (Sending extra data in
-	 * that last pckate should trigger an overflow fault.)  But in mode 1,
-	 * we don't get DMA completion interrrupt for short packets.
+	 * But in mode 1 we don't get a DMA completion interrupt for short
+	 * packets, and for most gadgets (g_ether, RNDIS, ...) request->length
+	 * is routinely more than what the host sends, the transfer being
+	 * ended by a short packet.  Such a request would never complete.
+	 * So mode 1 is only used when the gadget driver says the host sends
+	 * exactly request->length (req->short_not_ok, as g_file_storage
+	 * does), the packet already in the FIFO is full and the request has
+	 * room for more than that.
 	 *
-	 * Theoretically, we could enable DMAReq irq (MUSB_RXCSR_DMAMODE = 1),
-	 * to get endpoint interrupt on every DMA req, but that didn't seem
-	 * to work reliably.
-	 *
-	 * REVISIT an updated g_file_storage can set req->short_not_ok, which
-	 * then becomes usable as a runtime "use mode 1" hint...
+	 * NOTE the special sequence (enabling and then disabling
+	 * MUSB_RXCSR_DMAMODE) is required to get DMAReq to activate.
 	 */
+				if (musb_gadget_rx_mode1()
+						&& request->short_not_ok
+						&& len == musb_ep->packet_sz
+						&& request->length - request->actual
+							> musb_ep->packet_sz) {
+					u16	mode1_csr = csr | MUSB_RXCSR_AUTOCLEAR
+							| MUSB_RXCSR_DMAENAB;
+
+					musb_writew(epio, MUSB_RXCSR, mode1_csr
+						| MUSB_RXCSR_DMAMODE);
+					musb_writew(epio, MUSB_RXCSR, mode1_csr);
+
+					channel->desired_mode = 1;
+					use_dma = c->channel_program(
+							channel,
+							musb_ep->packet_sz,
+							1,
+							request->dma
+							+ request->actual,
+							min_t(unsigned,
+								request->length
+								- request->actual,
+								channel->max_len));
+					if (use_dma)
+						return;
+
+					/* engine refused mode 1; undo the setup */
+					musb_writew(epio, MUSB_RXCSR,
+						csr | MUSB_RXCSR_P_WZC_BITS);
+				}
 
 				csr |= MUSB_RXCSR_DMAENAB;
-#ifdef USE_MODE1
-				csr |= MUSB_RXCSR_AUTOCLEAR;
-				/* csr |= MUSB_RXCSR_DMAMODE; */
-
-				/* this special sequence (enabling and then
-				 * disabling MUSB_RXCSR_DMAMODE) is required
-				 * to get DMAReq to activate
-				 */
-				musb_writew(epio, MUSB_RXCSR,
-					csr | MUSB_RXCSR_DMAMODE);
-#else
 				if (!musb_ep->hb_mult &&
 					musb_ep->hw_ep->rx_double_buffered)
 					csr |= MUSB_RXCSR_AUTOCLEAR;
-#endif
 				musb_writew(epio, MUSB_RXCSR, csr);
 
 				if (request->actual < request->length) {
 					int transfer_size = 0;
-#ifdef USE_MODE1
-					transfer_size = min(request->length - request->actual,
-							channel->max_len);
-#else
+
 					transfer_size = min(request->length - request->actual,
 							(unsigned)len);
-#endif
-					if (transfer_size <= musb_ep->packet_sz)
-						musb_ep->dma->desired_mode = 0;
-					else
-						musb_ep->dma->desired_mode = 1;
+					musb_ep->dma->desired_mode = 0;
 
 					use_dma = c->channel_program(
 							channel,
@@ -332,6 +332,7 @@ static void configure_channel(struct dma_channel *channel,
 	if (buffer_is_aligned && (musb->hwvers >= MUSB_HWVERS_1800))
 		use_sdma = 0;
 
+	musb_channel->sdma_active = use_sdma;
 	if (use_sdma) {
 		musb_sdma_channel_program(musb, musb_channel, dma_addr, len);
 	} else { /* Mentor DMA */
@@ -390,6 +391,16 @@ static int dma_channel_program(struct dma_channel *channel,
 			&& (dma_addr % 4))
 		return false;
 
+	/*
+	 * The system DMA workaround copies whatever is in the FIFO without
+	 * DMAReq handshaking, so it cannot follow an RX mode 1 transfer
+	 * across packets.  Let the caller fall back to mode 0.
+	 */
+	if (mode && !musb_channel->transmit
+			&& musb_channel->sysdma_channel != -1
+			&& ((dma_addr & 0x3) || musb->hwvers < MUSB_HWVERS_1800))
+		return false;
+
 	channel->actual_len = 0;
 	musb_channel->start_addr = dma_addr;
 	musb_channel->len = len;
@@ -438,6 +449,13 @@ static int dma_channel_abort(struct dma_channel *channel)
 			musb_writew(mbase, offset, csr);
 		}
 
+		/* report how far the engine got, so an aborted mode 1
+		 * transfer still accounts for the packets already moved
+		 */
+		if (!musb_channel->sdma_active)
+			channel->actual_len = musb_read_hsdma_addr(mbase,
+					bchannel) - musb_channel->start_addr;
+
 		musb_writew(mbase,
 			MUSB_HSDMA_CHANNEL_OFFSET(bchannel, MUSB_HSDMA_CONTROL),
 			0);
@@ -161,6 +161,7 @@ struct musb_dma_channel {
 	u8				idx;
 	u8				epnum;
 	u8				transmit;
+	u8				sdma_active;
 	int                             sysdma_channel;
 };
 
@@ -32,6 +32,7 @@
 #include <linux/device.h>
 #include <linux/efi.h>
 #include <linux/fb.h>
+#include <linux/poll.h>
 
 #include <asm/fb.h>
 
@@ -1404,10 +1405,24 @@ __releases(&info->lock)
 	return 0;
 }
 
+static unsigned int
+fb_poll(struct file *file, poll_table *wait)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	int fbidx = iminor(inode);
+	struct fb_info *info = registered_fb[fbidx];
+
+	if (!info || !info->fbops->fb_poll)
+		return DEFAULT_POLLMASK;
+
+	return info->fbops->fb_poll(info, file, wait);
+}
+
 static const struct file_operations fb_fops = {
 	.owner =	THIS_MODULE,
 	.read =		fb_read,
 	.write =	fb_write,
+	.poll =		fb_poll,
 	.unlocked_ioctl = fb_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = fb_compat_ioctl,
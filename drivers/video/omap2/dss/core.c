@@ -35,6 +35,7 @@
 
 #include <plat/display.h>
 #include <plat/clock.h>
+#include <plat/omap-pm.h>
 
 #include "dss.h"
 #include "dss_features.h"
@@ -53,6 +54,9 @@ static struct {
 	struct regulator *vdds_dsi_reg;
 	struct regulator *vdds_sdi_reg;
 	struct regulator *vdda_dac_reg;
+
+	/* KiB/s */
+	unsigned long bus_tput;
 } core;
 
 static void dss_clk_enable_all_no_ctx(void);
@@ -404,6 +408,19 @@ struct regulator *dss_get_vdda_dac(void)
 	return reg;
 }
 
+/* Request enough interconnect throughput for DISPC to fetch tput KiB/s */
+void dss_set_min_bus_tput(unsigned long tput)
+{
+	if (core.bus_tput == tput)
+		return;
+
+	DSSDBG("bus tput %lu -> %lu KiB/s\n", core.bus_tput, tput);
+
+	if (omap_pm_set_min_bus_tput(&core.pdev->dev, OCP_INITIATOR_AGENT,
+				tput) == 0)
+		core.bus_tput = tput;
+}
+
 /* DEBUGFS */
 #if defined(CONFIG_DEBUG_FS) && defined(CONFIG_OMAP2_DSS_DEBUG_SUPPORT)
 static void dss_debug_dump_clocks(struct seq_file *s)
@@ -463,6 +480,8 @@ static int dss_initialize_debugfs(void)
 			&dss_dump_regs, &dss_debug_fops);
 	debugfs_create_file("dispc", S_IRUGO, dss_debugfs_dir,
 			&dispc_dump_regs, &dss_debug_fops);
+	debugfs_create_file("dispc_fifo", S_IRUGO, dss_debugfs_dir,
+			&dispc_dump_fifo, &dss_debug_fops);
 #ifdef CONFIG_OMAP2_DSS_RFBI
 	debugfs_create_file("rfbi", S_IRUGO, dss_debugfs_dir,
 			&rfbi_dump_regs, &dss_debug_fops);
@@ -32,6 +32,7 @@
 #include <linux/delay.h>
 #include <linux/workqueue.h>
 #include <linux/hardirq.h>
+#include <linux/moduleparam.h>
 
 #include <plat/sram.h>
 #include <plat/clock.h>
@@ -172,6 +173,26 @@ struct dispc_irq_stats {
 	unsigned irqs[32];
 };
 
+struct dispc_fifo_stats {
+	/* estimated fetch bandwidth, bytes per second */
+	unsigned long bandwidth;
+	enum omap_burst_size burst_size;
+	u32 fifo_low;
+	u32 fifo_high;
+	/* the FIFO is too small to cover the memory latency */
+	bool starved;
+	/* fetches get high priority in the interconnect arbitration */
+	bool high_prio;
+	unsigned underflows;
+};
+
+/* Worst case latency of a DISPC DMA request under memory load, used to size
+ * the data left in the FIFO when refill starts */
+static unsigned int fifo_latency_ns = 2000;
+module_param(fifo_latency_ns, uint, 0644);
+MODULE_PARM_DESC(fifo_latency_ns,
+		"Memory latency covered by the DISPC FIFO low threshold");
+
 static struct {
 	void __iomem    *base;
 
@@ -183,6 +204,8 @@ static struct {
 	u32 error_irqs;
 	struct work_struct error_work;
 
+	struct dispc_fifo_stats fifo_stats[MAX_DSS_OVERLAYS];
+
 	u32		ctx[DISPC_SZ_REGS / sizeof(u32)];
 
 #ifdef CONFIG_OMAP2_DSS_COLLECT_IRQ_STATS
@@ -192,6 +215,7 @@ static struct {
 } dispc;
 
 static void _omap_dispc_set_irqs(void);
+static int color_mode_to_bpp(enum omap_color_mode color_mode);
 
 static inline void dispc_write_reg(const struct dispc_reg idx, u32 val)
 {
@@ -923,6 +947,21 @@ void dispc_enable_replication(enum omap_plane plane, bool enable)
 	enable_clocks(0);
 }
 
+/* High priority planes win the DISPC DMA arbitration towards L3 */
+void dispc_enable_plane_high_prio(enum omap_plane plane, bool enable)
+{
+	int bit;
+
+	if (plane == OMAP_DSS_GFX)
+		bit = 14;
+	else
+		bit = 23;
+
+	enable_clocks(1);
+	REG_FLD_MOD(dispc_reg_att[plane], enable, bit, bit);
+	enable_clocks(0);
+}
+
 void dispc_set_lcd_size(u16 width, u16 height)
 {
 	u32 val;
@@ -994,6 +1033,109 @@ void dispc_setup_plane_fifo(enum omap_plane plane, u32 low, u32 high)
 	enable_clocks(0);
 }
 
+/* Calculate the burst size and FIFO thresholds of a plane from the rate at
+ * which the plane drains its FIFO. The low threshold never goes below the
+ * previous fixed value of fifo_size - 16x32 burst; it is raised, using the
+ * smaller 8x32 burst, when the data left in the FIFO at refill start would
+ * not cover fifo_latency_ns of memory latency (doubled for VRFB rotated
+ * fetches). Planes whose latency the FIFO cannot cover get high priority in
+ * the DMA arbitration. Returns the estimated fetch bandwidth in bytes/s. */
+unsigned long dispc_calc_fifo_thresholds(enum omap_plane plane, u32 fifo_size,
+		unsigned long pclk, enum omap_color_mode color_mode,
+		bool vrfb_rotated, u16 width, u16 height,
+		u16 out_width, u16 out_height,
+		enum omap_burst_size *burst_size, u32 *fifo_low, u32 *fifo_high,
+		bool *high_prio)
+{
+	struct dispc_fifo_stats *st = &dispc.fifo_stats[plane];
+	const unsigned default_burst_bytes = 16 * 32 / 8;
+	unsigned long flags;
+	unsigned burst_size_bytes;
+	unsigned latency_ns;
+	u64 bw, latency_bytes;
+	u32 low, default_low, max_low;
+
+	bw = (u64)pclk * color_mode_to_bpp(color_mode) / 8;
+
+	/* downscaling fetches more than one input pixel per output pixel */
+	if (out_width && width > out_width)
+		bw = div_u64(bw * width, out_width);
+	if (out_height && height > out_height)
+		bw = div_u64(bw * height, out_height);
+
+	latency_ns = fifo_latency_ns;
+	if (vrfb_rotated)
+		latency_ns *= 2;
+
+	latency_bytes = div_u64(bw * latency_ns, 1000000000);
+
+	/* the threshold used before tuning, never go below it */
+	default_low = fifo_size - default_burst_bytes;
+
+	/* refill has to start while the FIFO still holds latency_bytes */
+	low = roundup((u32)min_t(u64, latency_bytes, fifo_size),
+			8 * 32 / 8) + 8 * 32 / 8;
+
+	if (fifo_size >= 4 * default_burst_bytes && low <= default_low) {
+		*burst_size = OMAP_DSS_BURST_16x32;
+		burst_size_bytes = default_burst_bytes;
+	} else {
+		/* smaller bursts let the threshold sit closer to the top */
+		*burst_size = OMAP_DSS_BURST_8x32;
+		burst_size_bytes = 8 * 32 / 8;
+	}
+
+	max_low = fifo_size - burst_size_bytes;
+
+	*fifo_high = fifo_size - 1;
+	*fifo_low = clamp_t(u32, low, default_low, max_low);
+	*high_prio = low > max_low;
+
+	spin_lock_irqsave(&dispc.irq_lock, flags);
+	st->bandwidth = (unsigned long)bw;
+	st->burst_size = *burst_size;
+	st->fifo_low = *fifo_low;
+	st->fifo_high = *fifo_high;
+	st->starved = low > max_low;
+	st->high_prio = *high_prio;
+	spin_unlock_irqrestore(&dispc.irq_lock, flags);
+
+	if (low > max_low)
+		DSSDBG("fifo(%d) too small for %llu B/s\n", plane, bw);
+
+	return (unsigned long)bw;
+}
+
+void dispc_dump_fifo(struct seq_file *s)
+{
+	static const char * const burst_str[] = {
+		[OMAP_DSS_BURST_4x32] = "4x32",
+		[OMAP_DSS_BURST_8x32] = "8x32",
+		[OMAP_DSS_BURST_16x32] = "16x32",
+	};
+	struct dispc_fifo_stats stats[ARRAY_SIZE(dispc.fifo_stats)];
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&dispc.irq_lock, flags);
+	memcpy(stats, dispc.fifo_stats, sizeof(stats));
+	spin_unlock_irqrestore(&dispc.irq_lock, flags);
+
+	seq_printf(s, "latency %u ns\n", fifo_latency_ns);
+
+	for (i = 0; i < dss_feat_get_num_ovls(); ++i) {
+		seq_printf(s, "plane %d: size %u low %u high %u burst %s%s\n",
+				i, dispc.fifo_size[i],
+				stats[i].fifo_low, stats[i].fifo_high,
+				burst_str[stats[i].burst_size],
+				stats[i].high_prio ? " high-prio" : "");
+		seq_printf(s, "\tbandwidth %lu B/s%s underflows %u\n",
+				stats[i].bandwidth,
+				stats[i].starved ? " (starved)" : "",
+				stats[i].underflows);
+	}
+}
+
 void dispc_enable_fifomerge(bool enable)
 {
 	enable_clocks(1);
@@ -2769,6 +2911,13 @@ void dispc_irq_handler(void)
 
 	spin_lock(&dispc.irq_lock);
 
+	if (irqstatus & DISPC_IRQ_GFX_FIFO_UNDERFLOW)
+		dispc.fifo_stats[OMAP_DSS_GFX].underflows++;
+	if (irqstatus & DISPC_IRQ_VID1_FIFO_UNDERFLOW)
+		dispc.fifo_stats[OMAP_DSS_VIDEO1].underflows++;
+	if (irqstatus & DISPC_IRQ_VID2_FIFO_UNDERFLOW)
+		dispc.fifo_stats[OMAP_DSS_VIDEO2].underflows++;
+
 	unhandled_errors = irqstatus & ~handledirqs & dispc.irq_error_mask;
 
 	if (unhandled_errors) {
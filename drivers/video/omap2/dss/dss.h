@@ -178,6 +178,7 @@ struct bus_type *dss_get_bus(void);
 struct regulator *dss_get_vdds_dsi(void);
 struct regulator *dss_get_vdds_sdi(void);
 struct regulator *dss_get_vdda_dac(void);
+void dss_set_min_bus_tput(unsigned long tput);
 
 /* display */
 int dss_suspend_all_devices(void);
@@ -339,9 +340,17 @@ void dispc_set_lcd_size(u16 width, u16 height);
 void dispc_set_digit_size(u16 width, u16 height);
 u32 dispc_get_plane_fifo_size(enum omap_plane plane);
 void dispc_setup_plane_fifo(enum omap_plane plane, u32 low, u32 high);
+unsigned long dispc_calc_fifo_thresholds(enum omap_plane plane, u32 fifo_size,
+		unsigned long pclk, enum omap_color_mode color_mode,
+		bool vrfb_rotated, u16 width, u16 height,
+		u16 out_width, u16 out_height,
+		enum omap_burst_size *burst_size, u32 *fifo_low, u32 *fifo_high,
+		bool *high_prio);
+void dispc_dump_fifo(struct seq_file *s);
 void dispc_enable_fifomerge(bool enable);
 void dispc_set_burst_size(enum omap_plane plane,
 		enum omap_burst_size burst_size);
+void dispc_enable_plane_high_prio(enum omap_plane plane, bool enable);
 
 void dispc_set_plane_ba0(enum omap_plane plane, u32 paddr);
 void dispc_set_plane_ba1(enum omap_plane plane, u32 paddr);
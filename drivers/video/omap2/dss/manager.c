@@ -28,6 +28,7 @@
 #include <linux/platform_device.h>
 #include <linux/spinlock.h>
 #include <linux/jiffies.h>
+#include <linux/wait.h>
 
 #include <plat/display.h>
 #include <plat/cpu.h>
@@ -38,6 +39,11 @@
 static int num_managers;
 static struct list_head manager_list;
 
+static unsigned int flip_queue_depth = 2;
+module_param(flip_queue_depth, uint, 0644);
+MODULE_PARM_DESC(flip_queue_depth,
+		"Max number of page flips queued per manager (1-3)");
+
 static ssize_t manager_name_show(struct omap_overlay_manager *mgr, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%s\n", mgr->name);
@@ -414,6 +420,7 @@ struct overlay_cache_data {
 	enum omap_burst_size burst_size;
 	u32 fifo_low;
 	u32 fifo_high;
+	bool high_prio;
 
 	bool manual_update;
 };
@@ -447,10 +454,27 @@ struct manager_cache_data {
 	bool enlarge_update_area;
 };
 
+/* Page flips queued with queue_flip(). The oldest flip is moved to the
+ * overlay cache when the previous one has reached the real registers, so at
+ * most one flip is in the cache/shadow registers at any time. */
+struct flip_queue_data {
+	struct omap_dss_flip flips[OMAP_DSS_FLIP_QUEUE_MAX];
+	/* index of the oldest queued flip */
+	unsigned head;
+	/* number of queued flips, not including the one in flight */
+	unsigned count;
+	/* a flip has been written to the cache, waiting for VSYNC */
+	bool in_flight;
+
+	u32 queued_seq;
+	u32 done_seq;
+};
+
 static struct {
 	spinlock_t lock;
 	struct overlay_cache_data overlay_cache[MAX_DSS_OVERLAYS];
 	struct manager_cache_data manager_cache[MAX_DSS_MANAGERS];
+	struct flip_queue_data flip_queue[MAX_DSS_MANAGERS];
 
 	bool irq_enabled;
 } dss_cache;
@@ -855,6 +879,7 @@ static int configure_overlay(enum omap_plane plane)
 
 	dispc_set_burst_size(plane, c->burst_size);
 	dispc_setup_plane_fifo(plane, c->fifo_low, c->fifo_high);
+	dispc_enable_plane_high_prio(plane, c->high_prio);
 
 	dispc_enable_plane(plane, 1);
 
@@ -1148,6 +1173,99 @@ void dss_start_update(struct omap_dss_device *dssdev)
 	dssdev->manager->enable(dssdev->manager);
 }
 
+/* Called with dss_cache.lock held. Writes the flip to the overlay cache, from
+ * where configure_dispc() takes it to the shadow registers. */
+static void dss_flip_to_cache(enum omap_channel channel,
+		const struct omap_dss_flip *flip)
+{
+	struct overlay_cache_data *oc;
+	struct omap_overlay *ovl;
+	int i;
+
+	for (i = 0; i < flip->num_overlays; ++i) {
+		ovl = flip->ovls[i].ovl;
+		oc = &dss_cache.overlay_cache[ovl->id];
+
+		/* keep info in sync, so that a later apply() does not
+		 * revert to an old buffer */
+		ovl->info.paddr = flip->ovls[i].paddr;
+		ovl->info.vaddr = flip->ovls[i].vaddr;
+
+		if (!oc->enabled || oc->channel != channel)
+			continue;
+
+		oc->paddr = flip->ovls[i].paddr;
+		oc->vaddr = flip->ovls[i].vaddr;
+		oc->dirty = true;
+	}
+
+	dss_cache.flip_queue[channel].in_flight = true;
+}
+
+static bool dss_flip_in_hw(enum omap_channel channel,
+		const struct omap_dss_flip *flip)
+{
+	struct overlay_cache_data *oc;
+	int i;
+
+	for (i = 0; i < flip->num_overlays; ++i) {
+		oc = &dss_cache.overlay_cache[flip->ovls[i].ovl->id];
+
+		if (oc->channel != channel)
+			continue;
+
+		if (oc->dirty || oc->shadow_dirty)
+			return false;
+	}
+
+	return true;
+}
+
+/* Called with dss_cache.lock held, when the manager's GO bit is clear. Retires
+ * the flip in flight if it has reached the registers, and moves the next
+ * queued flip to the cache. */
+static void dss_flip_queue_advance(enum omap_channel channel)
+{
+	struct flip_queue_data *fq = &dss_cache.flip_queue[channel];
+	struct omap_overlay_manager *mgr;
+	unsigned last;
+
+	if (!fq->in_flight)
+		return;
+
+	last = (fq->head + OMAP_DSS_FLIP_QUEUE_MAX - 1) %
+		OMAP_DSS_FLIP_QUEUE_MAX;
+	if (!dss_flip_in_hw(channel, &fq->flips[last]))
+		return;
+
+	fq->in_flight = false;
+	fq->done_seq++;
+
+	if (fq->count) {
+		dss_flip_to_cache(channel, &fq->flips[fq->head]);
+		fq->head = (fq->head + 1) % OMAP_DSS_FLIP_QUEUE_MAX;
+		fq->count--;
+	}
+
+	list_for_each_entry(mgr, &manager_list, list) {
+		if (mgr->id == channel)
+			wake_up_all(&mgr->flip_wait);
+	}
+}
+
+/* Called with dss_cache.lock held. Drops all pending flips, used when the
+ * manager is disabled and no more VSYNCs will arrive. */
+static void dss_flip_queue_flush(struct omap_overlay_manager *mgr)
+{
+	struct flip_queue_data *fq = &dss_cache.flip_queue[mgr->id];
+
+	fq->done_seq = fq->queued_seq;
+	fq->in_flight = false;
+	fq->count = 0;
+
+	wake_up_all(&mgr->flip_wait);
+}
+
 static void dss_apply_irq_handler(void *data, u32 mask)
 {
 	struct manager_cache_data *mc;
@@ -1174,6 +1292,11 @@ static void dss_apply_irq_handler(void *data, u32 mask)
 			mc->shadow_dirty = false;
 	}
 
+	for (i = 0; i < num_mgrs; ++i) {
+		if (!mgr_busy[i])
+			dss_flip_queue_advance(i);
+	}
+
 	r = configure_dispc();
 	if (r == 1)
 		goto end;
@@ -1182,10 +1305,10 @@ static void dss_apply_irq_handler(void *data, u32 mask)
 	mgr_busy[0] = dispc_go_busy(0);
 	mgr_busy[1] = dispc_go_busy(1);
 
-	/* keep running as long as there are busy managers, so that
-	 * we can collect overlay-applied information */
+	/* keep running as long as there are busy managers or flips in
+	 * flight, so that we can collect overlay-applied information */
 	for (i = 0; i < num_mgrs; ++i) {
-		if (mgr_busy[i])
+		if (mgr_busy[i] || dss_cache.flip_queue[i].in_flight)
 			goto end;
 	}
 
@@ -1206,6 +1329,7 @@ static int omap_dss_mgr_apply(struct omap_overlay_manager *mgr)
 	struct omap_overlay *ovl;
 	int num_planes_enabled = 0;
 	bool use_fifomerge;
+	unsigned long bandwidth = 0;
 	unsigned long flags;
 	int r;
 
@@ -1359,11 +1483,23 @@ static int omap_dss_mgr_apply(struct omap_overlay_manager *mgr)
 		if (use_fifomerge)
 			size *= 3;
 
+		oc->high_prio = false;
+
 		switch (dssdev->type) {
 		case OMAP_DISPLAY_TYPE_DPI:
-		case OMAP_DISPLAY_TYPE_DBI:
 		case OMAP_DISPLAY_TYPE_SDI:
 		case OMAP_DISPLAY_TYPE_VENC:
+			bandwidth += dispc_calc_fifo_thresholds(ovl->id, size,
+					dssdev->panel.timings.pixel_clock * 1000,
+					oc->color_mode,
+					oc->rotation_type == OMAP_DSS_ROT_VRFB &&
+						(oc->rotation & 1),
+					oc->width, oc->height,
+					oc->out_width, oc->out_height,
+					&oc->burst_size, &oc->fifo_low,
+					&oc->fifo_high, &oc->high_prio);
+			break;
+		case OMAP_DISPLAY_TYPE_DBI:
 			default_get_overlay_fifo_thresholds(ovl->id, size,
 					&oc->burst_size, &oc->fifo_low,
 					&oc->fifo_high);
@@ -1393,9 +1529,122 @@ static int omap_dss_mgr_apply(struct omap_overlay_manager *mgr)
 
 	spin_unlock_irqrestore(&dss_cache.lock, flags);
 
+	/* keep the interconnect fast enough for all enabled planes */
+	dss_set_min_bus_tput(bandwidth / 1024);
+
+	return r;
+}
+
+static int dss_mgr_queue_flip(struct omap_overlay_manager *mgr,
+		const struct omap_dss_flip *flip, u32 *seq)
+{
+	struct flip_queue_data *fq = &dss_cache.flip_queue[mgr->id];
+	struct omap_dss_device *dssdev = mgr->device;
+	unsigned long flags;
+	unsigned depth;
+	int i, r;
+
+	if (!dssdev || dssdev->state != OMAP_DSS_DISPLAY_ACTIVE)
+		return -ENODEV;
+
+	/* manual update displays take new buffers with update() */
+	if (dssdev->caps & OMAP_DSS_DISPLAY_CAP_MANUAL_UPDATE)
+		return -EINVAL;
+
+	if (flip->num_overlays < 1 ||
+			flip->num_overlays > OMAP_DSS_FLIP_MAX_OVERLAYS)
+		return -EINVAL;
+
+	for (i = 0; i < flip->num_overlays; ++i) {
+		if (!flip->ovls[i].ovl || flip->ovls[i].ovl->manager != mgr)
+			return -EINVAL;
+	}
+
+	depth = clamp_t(unsigned, flip_queue_depth, 1,
+			OMAP_DSS_FLIP_QUEUE_MAX);
+
+	spin_lock_irqsave(&dss_cache.lock, flags);
+
+	if (fq->count + (fq->in_flight ? 1 : 0) >= depth) {
+		spin_unlock_irqrestore(&dss_cache.lock, flags);
+		return -EBUSY;
+	}
+
+	if (fq->in_flight) {
+		i = (fq->head + fq->count) % OMAP_DSS_FLIP_QUEUE_MAX;
+		fq->flips[i] = *flip;
+		fq->count++;
+	} else {
+		/* the flip in flight is kept in the slot just before head */
+		fq->flips[fq->head] = *flip;
+		fq->head = (fq->head + 1) % OMAP_DSS_FLIP_QUEUE_MAX;
+		dss_flip_to_cache(mgr->id, flip);
+	}
+
+	if (seq)
+		*seq = ++fq->queued_seq;
+	else
+		++fq->queued_seq;
+
+	r = 0;
+	dss_clk_enable(DSS_CLK_ICK | DSS_CLK_FCK1);
+	if (!dss_cache.irq_enabled) {
+		r = omap_dispc_register_isr(dss_apply_irq_handler, NULL,
+				DISPC_IRQ_VSYNC	| DISPC_IRQ_EVSYNC_ODD |
+				DISPC_IRQ_EVSYNC_EVEN);
+		dss_cache.irq_enabled = true;
+	}
+	configure_dispc();
+	dss_clk_disable(DSS_CLK_ICK | DSS_CLK_FCK1);
+
+	spin_unlock_irqrestore(&dss_cache.lock, flags);
+
 	return r;
 }
 
+/* returns the number of flips not yet taken into use */
+static int dss_mgr_get_flip_status(struct omap_overlay_manager *mgr,
+		u32 *done_seq)
+{
+	struct flip_queue_data *fq = &dss_cache.flip_queue[mgr->id];
+	unsigned long flags;
+	int pending;
+
+	spin_lock_irqsave(&dss_cache.lock, flags);
+	pending = fq->count + (fq->in_flight ? 1 : 0);
+	if (done_seq)
+		*done_seq = fq->done_seq;
+	spin_unlock_irqrestore(&dss_cache.lock, flags);
+
+	return pending;
+}
+
+static bool dss_mgr_flip_done(struct omap_overlay_manager *mgr, u32 seq)
+{
+	u32 done_seq;
+
+	dss_mgr_get_flip_status(mgr, &done_seq);
+
+	return (s32)(done_seq - seq) >= 0;
+}
+
+static int dss_mgr_wait_for_flip(struct omap_overlay_manager *mgr, u32 seq)
+{
+	unsigned long timeout = msecs_to_jiffies(500);
+	long r;
+
+	r = wait_event_interruptible_timeout(mgr->flip_wait,
+			dss_mgr_flip_done(mgr, seq), timeout);
+	if (r < 0)
+		return r;
+	if (r == 0) {
+		DSSERR("mgr(%d)->wait_for_flip() timeout\n", mgr->id);
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
 static int dss_check_manager(struct omap_overlay_manager *mgr)
 {
 	/* OMAP supports only graphics source transparency color key and alpha
@@ -1442,7 +1691,14 @@ static int dss_mgr_enable(struct omap_overlay_manager *mgr)
 
 static int dss_mgr_disable(struct omap_overlay_manager *mgr)
 {
+	unsigned long flags;
+
 	dispc_enable_channel(mgr->id, 0);
+
+	spin_lock_irqsave(&dss_cache.lock, flags);
+	dss_flip_queue_flush(mgr);
+	spin_unlock_irqrestore(&dss_cache.lock, flags);
+
 	return 0;
 }
 
@@ -1486,6 +1742,11 @@ int dss_init_overlay_managers(struct platform_device *pdev)
 		mgr->get_manager_info = &omap_dss_mgr_get_info;
 		mgr->wait_for_go = &dss_mgr_wait_for_go;
 		mgr->wait_for_vsync = &dss_mgr_wait_for_vsync;
+		mgr->queue_flip = &dss_mgr_queue_flip;
+		mgr->get_flip_status = &dss_mgr_get_flip_status;
+		mgr->wait_for_flip = &dss_mgr_wait_for_flip;
+
+		init_waitqueue_head(&mgr->flip_wait);
 
 		mgr->enable = &dss_mgr_enable;
 		mgr->disable = &dss_mgr_disable;
@@ -590,11 +590,23 @@ static int omapfb_wait_for_go(struct fb_info *fbi)
 	return r;
 }
 
+/* the manager handling the page flips of this fb */
+static struct omap_overlay_manager *omapfb_flip_manager(struct fb_info *fbi)
+{
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+
+	if (ofbi->num_overlays == 0)
+		return NULL;
+
+	return ofbi->overlays[0]->manager;
+}
+
 int omapfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 {
 	struct omapfb_info *ofbi = FB2OFB(fbi);
 	struct omapfb2_device *fbdev = ofbi->fbdev;
 	struct omap_dss_device *display = fb2display(fbi);
+	struct omap_overlay_manager *mgr;
 
 	union {
 		struct omapfb_update_window_old	uwnd_o;
@@ -610,7 +622,9 @@ int omapfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 		struct omapfb_vram_info		vram_info;
 		struct omapfb_tearsync_info	tearsync_info;
 		struct omapfb_display_info	display_info;
+		struct omapfb_flip_info		flip_info;
 		u32				crt;
+		u32				seq;
 	} p;
 
 	int r = 0;
@@ -800,6 +814,57 @@ int omapfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 		r = omapfb_wait_for_go(fbi);
 		break;
 
+	case OMAPFB_QUEUE_FLIP:
+		DBG("ioctl QUEUE_FLIP\n");
+		if (copy_from_user(&p.flip_info, (void __user *)arg,
+					sizeof(p.flip_info))) {
+			r = -EFAULT;
+			break;
+		}
+
+		r = omapfb_queue_flip(fbi, &p.flip_info);
+		if (r)
+			break;
+
+		if (copy_to_user((void __user *)arg, &p.flip_info,
+					sizeof(p.flip_info)))
+			r = -EFAULT;
+		break;
+
+	case OMAPFB_GET_FLIP_STATUS:
+		DBG("ioctl GET_FLIP_STATUS\n");
+		mgr = omapfb_flip_manager(fbi);
+		if (!mgr) {
+			r = -EINVAL;
+			break;
+		}
+
+		memset(&p.flip_info, 0, sizeof(p.flip_info));
+		p.flip_info.xoffset = fbi->var.xoffset;
+		p.flip_info.yoffset = fbi->var.yoffset;
+		p.flip_info.pending = mgr->get_flip_status(mgr,
+				&p.flip_info.seq);
+
+		if (copy_to_user((void __user *)arg, &p.flip_info,
+					sizeof(p.flip_info)))
+			r = -EFAULT;
+		break;
+
+	case OMAPFB_WAIT_FOR_FLIP:
+		DBG("ioctl WAIT_FOR_FLIP\n");
+		if (get_user(p.seq, (__u32 __user *)arg)) {
+			r = -EFAULT;
+			break;
+		}
+		mgr = omapfb_flip_manager(fbi);
+		if (!mgr) {
+			r = -EINVAL;
+			break;
+		}
+
+		r = mgr->wait_for_flip(mgr, p.seq);
+		break;
+
 	/* LCD and CTRL tests do the same thing for backward
 	 * compatibility */
 	case OMAPFB_LCD_TEST:
@@ -29,6 +29,7 @@
 #include <linux/device.h>
 #include <linux/platform_device.h>
 #include <linux/omapfb.h>
+#include <linux/poll.h>
 
 #include <plat/display.h>
 #include <plat/vram.h>
@@ -1049,6 +1050,65 @@ err:
 	return r;
 }
 
+/* pan to fi->xoffset/yoffset at the next free VSYNC, without blocking */
+int omapfb_queue_flip(struct fb_info *fbi, struct omapfb_flip_info *fi)
+{
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	struct fb_var_screeninfo new_var = fbi->var;
+	struct omap_overlay_manager *mgr = NULL;
+	struct omap_dss_flip flip;
+	int r = 0;
+	int i;
+
+	if (ofbi->num_overlays == 0 ||
+			ofbi->num_overlays > OMAP_DSS_FLIP_MAX_OVERLAYS)
+		return -EINVAL;
+
+	if (fi->xoffset + new_var.xres > new_var.xres_virtual ||
+			fi->yoffset + new_var.yres > new_var.yres_virtual)
+		return -EINVAL;
+
+	new_var.xoffset = fi->xoffset;
+	new_var.yoffset = fi->yoffset;
+
+	omapfb_get_mem_region(ofbi->region);
+
+	if (ofbi->region->size == 0) {
+		r = -EINVAL;
+		goto out;
+	}
+
+	memset(&flip, 0, sizeof(flip));
+
+	for (i = 0; i < ofbi->num_overlays; i++) {
+		struct omap_overlay *ovl = ofbi->overlays[i];
+		int rotation = (new_var.rotate + ofbi->rotation[i]) % 4;
+
+		/* all overlays have to change at the same VSYNC */
+		if (!ovl->manager || (mgr && ovl->manager != mgr)) {
+			r = -EINVAL;
+			goto out;
+		}
+		mgr = ovl->manager;
+
+		flip.ovls[i].ovl = ovl;
+		omapfb_calc_addr(ofbi, &new_var, &fbi->fix, rotation,
+				 &flip.ovls[i].paddr, &flip.ovls[i].vaddr);
+	}
+	flip.num_overlays = ofbi->num_overlays;
+
+	r = mgr->queue_flip(mgr, &flip, &fi->seq);
+	if (r)
+		goto out;
+
+	fbi->var.xoffset = fi->xoffset;
+	fbi->var.yoffset = fi->yoffset;
+out:
+	omapfb_put_mem_region(ofbi->region);
+
+	return r;
+}
+
 /* checks var and eventually tweaks it to something supported,
  * DO NOT MODIFY PAR */
 static int omapfb_check_var(struct fb_var_screeninfo *var, struct fb_info *fbi)
@@ -1357,6 +1417,25 @@ ssize_t omapfb_write(struct fb_info *info, const char __user *buf,
 }
 #endif
 
+static unsigned int omapfb_poll(struct fb_info *fbi, struct file *file,
+		struct poll_table_struct *wait)
+{
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	struct omap_overlay_manager *mgr;
+
+	if (ofbi->num_overlays == 0 || !ofbi->overlays[0]->manager)
+		return POLLERR;
+
+	mgr = ofbi->overlays[0]->manager;
+
+	poll_wait(file, &mgr->flip_wait, wait);
+
+	if (mgr->get_flip_status(mgr, NULL) == 0)
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
 static struct fb_ops omapfb_ops = {
 	.owner          = THIS_MODULE,
 	.fb_open        = omapfb_open,
@@ -1370,6 +1449,7 @@ static struct fb_ops omapfb_ops = {
 	.fb_set_par     = omapfb_set_par,
 	.fb_pan_display = omapfb_pan_display,
 	.fb_mmap	= omapfb_mmap,
+	.fb_poll	= omapfb_poll,
 	.fb_setcolreg	= omapfb_setcolreg,
 	.fb_setcmap	= omapfb_setcmap,
 	/*.fb_write	= omapfb_write,*/
@@ -386,7 +386,7 @@ static int nfs_inode_add_request(struct inode *inode, struct nfs_page *req)
 	error = radix_tree_insert(&nfsi->nfs_page_tree, req->wb_index, req);
 	BUG_ON(error);
 	if (!nfsi->npages) {
-		igrab(inode);
+		ihold(inode);
 		if (nfs_have_delegation(inode, FMODE_WRITE))
 			nfsi->change_attr++;
 	}
@@ -542,8 +542,12 @@ nfs_scan_commit(struct inode *inode, struct list_head *dst, pgoff_t idx_start, u
 	ret = nfs_scan_list(nfsi, dst, idx_start, npages, NFS_PAGE_TAG_COMMIT);
 	if (ret > 0)
 		nfsi->ncommit -= ret;
-	if (nfs_need_commit(NFS_I(inode)))
+	if (nfs_need_commit(NFS_I(inode))) {
+		/* __mark_inode_dirty() takes i_lock itself */
+		spin_unlock(&inode->i_lock);
 		__mark_inode_dirty(inode, I_DIRTY_DATASYNC);
+		spin_lock(&inode->i_lock);
+	}
 	return ret;
 }
 #else
@@ -91,7 +91,7 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/srcu.h>
-#include <linux/writeback.h> /* for inode_lock */
+#include <linux/writeback.h> /* for inode_sb_list_lock */
 
 #include <asm/atomic.h>
 
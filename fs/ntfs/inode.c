@@ -54,8 +54,8 @@
  *
  * Return 1 if the attributes match and 0 if not.
  *
- * NOTE: This function runs with the inode_lock spin lock held so it is not
- * allowed to sleep.
+ * NOTE: This function runs with the inode_hash_lock spin lock held so it is
+ * not allowed to sleep.
  */
 int ntfs_test_inode(struct inode *vi, ntfs_attr *na)
 {
@@ -98,8 +98,8 @@ int ntfs_test_inode(struct inode *vi, ntfs_attr *na)
  *
  * Return 0 on success and -errno on error.
  *
- * NOTE: This function runs with the inode_lock spin lock held so it is not
- * allowed to sleep. (Hence the GFP_ATOMIC allocation.)
+ * NOTE: This function runs with the inode_hash_lock spin lock held so it is
+ * not allowed to sleep. (Hence the GFP_ATOMIC allocation.)
  */
 static int ntfs_init_locked_inode(struct inode *vi, ntfs_attr *na)
 {
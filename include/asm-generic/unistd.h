@@ -646,9 +646,17 @@ __SYSCALL(__NR_prlimit64, sys_prlimit64)
 __SYSCALL(__NR_fanotify_init, sys_fanotify_init)
 #define __NR_fanotify_mark 263
 __SYSCALL(__NR_fanotify_mark, sys_fanotify_mark)
+/* 264 - 268 reserved */
+__SYSCALL(264, sys_ni_syscall)
+__SYSCALL(265, sys_ni_syscall)
+__SYSCALL(266, sys_ni_syscall)
+__SYSCALL(267, sys_ni_syscall)
+__SYSCALL(268, sys_ni_syscall)
+#define __NR_sendmmsg 269
+__SC_COMP(__NR_sendmmsg, sys_sendmmsg, compat_sys_sendmmsg)
 
 #undef __NR_syscalls
-#define __NR_syscalls 264
+#define __NR_syscalls 270
 
 /*
  * All syscalls below here should go away really,
@@ -186,6 +186,23 @@ int twl_i2c_read_u8(u8 mod_no, u8 *val, u8 reg);
 int twl_i2c_write(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes);
 int twl_i2c_read(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes);
 
+/*
+ * Batch several of the above, possibly spanning slave addresses, into
+ * a single combined I2C transaction.  Each op follows the buffer rules
+ * of twl_i2c_read() or twl_i2c_write() depending on @write.
+ */
+#define TWL_I2C_MULTI_MAX	16
+
+struct twl_i2c_op {
+	u8		mod_no;
+	u8		reg;
+	bool		write;
+	u8		*value;
+	unsigned	num_bytes;
+};
+
+int twl_i2c_xfer_multi(struct twl_i2c_op *ops, int num);
+
 int twl_get_type(void);
 int twl_get_version(void);
 
@@ -58,6 +58,9 @@
 #define OMAPFB_GET_VRAM_INFO	OMAP_IOR(61, struct omapfb_vram_info)
 #define OMAPFB_SET_TEARSYNC	OMAP_IOW(62, struct omapfb_tearsync_info)
 #define OMAPFB_GET_DISPLAY_INFO	OMAP_IOR(63, struct omapfb_display_info)
+#define OMAPFB_QUEUE_FLIP	OMAP_IOWR(64, struct omapfb_flip_info)
+#define OMAPFB_GET_FLIP_STATUS	OMAP_IOR(65, struct omapfb_flip_info)
+#define OMAPFB_WAIT_FOR_FLIP	OMAP_IOW(66, __u32)
 
 #define OMAPFB_CAPS_GENERIC_MASK	0x00000fff
 #define OMAPFB_CAPS_LCDC_MASK		0x00fff000
@@ -203,6 +206,21 @@ struct omapfb_vram_info {
 	__u32 reserved[5];
 };
 
+/*
+ * OMAPFB_QUEUE_FLIP pans to xoffset/yoffset at a later VSYNC without
+ * blocking and returns the sequence number of the flip in seq.
+ * OMAPFB_GET_FLIP_STATUS returns the sequence number of the last flip
+ * that is on screen and the number of flips still pending. poll() on the
+ * fb reports POLLIN once no flips are pending.
+ */
+struct omapfb_flip_info {
+	__u32 xoffset;
+	__u32 yoffset;
+	__u32 seq;
+	__u32 pending;
+	__u32 reserved[4];
+};
+
 struct omapfb_tearsync_info {
 	__u8 enabled;
 	__u8 reserved1[3];
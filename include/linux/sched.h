@@ -97,6 +97,7 @@ struct exec_domain;
 struct futex_pi_state;
 struct robust_list_head;
 struct bio_list;
+struct blk_plug;
 struct fs_struct;
 struct perf_event_context;
 
@@ -1412,6 +1413,11 @@ struct task_struct {
 /* stacked block device info */
 	struct bio_list *bio_list;
 
+#ifdef CONFIG_BLOCK
+/* stack plugging */
+	struct blk_plug *plug;
+#endif
+
 /* VM state */
 	struct reclaim_state *reclaim_state;
 
@@ -9,7 +9,8 @@
 
 struct backing_dev_info;
 
-extern spinlock_t inode_lock;
+extern spinlock_t inode_wb_list_lock;
+extern spinlock_t inode_sb_list_lock;
 
 /*
  * fs/fs-writeback.c
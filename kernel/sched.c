@@ -72,6 +72,7 @@
 #include <linux/ctype.h>
 #include <linux/ftrace.h>
 #include <linux/slab.h>
+#include <linux/blkdev.h>
 
 #include <asm/tlb.h>
 #include <asm/irq_regs.h>
@@ -4086,6 +4087,14 @@ need_resched_nonpreemptible:
 	if (sched_feat(HRTICK))
 		hrtick_clear(rq);
 
+	/*
+	 * If we are going to sleep with plugged IO, submit it now: whatever
+	 * we are waiting for may well depend on it.
+	 */
+	if (prev->state && !(preempt_count() & PREEMPT_ACTIVE) &&
+	    blk_needs_flush_plug(prev))
+		blk_flush_plug(prev);
+
 	raw_spin_lock_irq(&rq->lock);
 
 	switch_count = &prev->nivcsw;
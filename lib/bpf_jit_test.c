@@ -0,0 +1,246 @@
+/*
+ * Check the BPF JIT against the interpreter
+ *
+ * Every filter of a small corpus is compiled with the JIT and run, along
+ * with sk_run_filter(), over a linear, a fragmented and a truncated copy
+ * of a TCP packet. Both must return the same verdict.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#define pr_fmt(fmt) "bpf_jit_test: " fmt
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/skbuff.h>
+#include <linux/filter.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#define MAX_INSNS	16
+
+struct bpf_test {
+	const char *name;
+	unsigned len;
+	struct sock_filter insns[MAX_INSNS];
+};
+
+#define TEST(n, ...) {							\
+	.name	= n,							\
+	.len	= ARRAY_SIZE(((struct sock_filter []){ __VA_ARGS__ })),	\
+	.insns	= { __VA_ARGS__ },					\
+}
+
+static struct bpf_test tests[] __initdata = {
+	TEST("ret_k",
+	     BPF_STMT(BPF_RET | BPF_K, 0xffff)),
+	/* tcpdump -dd "ip and tcp dst port 80" */
+	TEST("tcp_dst_port",
+	     BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+	     BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 8),
+	     BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+	     BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 6),
+	     BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+	     BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 4, 0),
+	     BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+	     BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+	     BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 80, 0, 1),
+	     BPF_STMT(BPF_RET | BPF_K, 0xffff),
+	     BPF_STMT(BPF_RET | BPF_K, 0)),
+	TEST("ld_word_abs",
+	     BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 30),
+	     BPF_STMT(BPF_RET | BPF_A, 0)),
+	TEST("ld_abs_beyond_end",
+	     BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 61),
+	     BPF_STMT(BPF_RET | BPF_K, 1)),
+	TEST("ld_ind_beyond_end",
+	     BPF_STMT(BPF_LDX | BPF_IMM, 1000),
+	     BPF_STMT(BPF_LD | BPF_W | BPF_IND, 0),
+	     BPF_STMT(BPF_RET | BPF_K, 1)),
+	TEST("ld_net_ll_off",
+	     BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF + 9),
+	     BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	     BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 12),
+	     BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	     BPF_STMT(BPF_RET | BPF_A, 0)),
+	/* X + k reaching the ancillary range is read as ancillary data */
+	TEST("ld_ind_ancillary",
+	     BPF_STMT(BPF_LDX | BPF_IMM, SKF_AD_OFF),
+	     BPF_STMT(BPF_LD | BPF_H | BPF_IND, SKF_AD_PROTOCOL),
+	     BPF_STMT(BPF_RET | BPF_A, 0)),
+	TEST("ld_ind_ancillary_fail",
+	     BPF_STMT(BPF_LDX | BPF_IMM, SKF_AD_OFF),
+	     BPF_STMT(BPF_LD | BPF_W | BPF_IND, SKF_AD_IFINDEX),
+	     BPF_STMT(BPF_RET | BPF_K, 1)),
+	TEST("msh_beyond_end",
+	     BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 1000),
+	     BPF_STMT(BPF_RET | BPF_K, 1)),
+	TEST("alu",
+	     BPF_STMT(BPF_LD | BPF_IMM, 0x12345678),
+	     BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 0x1000),
+	     BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 3),
+	     BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 7),
+	     BPF_STMT(BPF_ALU | BPF_DIV | BPF_K, 5),
+	     BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xff00ff),
+	     BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x80000000),
+	     BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 3),
+	     BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 1),
+	     BPF_STMT(BPF_LDX | BPF_W | BPF_LEN, 0),
+	     BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+	     BPF_STMT(BPF_ALU | BPF_NEG, 0),
+	     BPF_STMT(BPF_RET | BPF_A, 0)),
+	TEST("div_x_zero",
+	     BPF_STMT(BPF_LDX | BPF_IMM, 0),
+	     BPF_STMT(BPF_LD | BPF_IMM, 5),
+	     BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+	     BPF_STMT(BPF_RET | BPF_K, 1)),
+	TEST("scratch_mem",
+	     BPF_STMT(BPF_LD | BPF_MEM, 3),
+	     BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 9),
+	     BPF_STMT(BPF_ST, 1),
+	     BPF_STMT(BPF_LDX | BPF_MEM, 1),
+	     BPF_STMT(BPF_STX, 15),
+	     BPF_STMT(BPF_LD | BPF_MEM, 15),
+	     BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	     BPF_STMT(BPF_RET | BPF_A, 0)),
+	TEST("jumps",
+	     BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+	     BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 40, 0, 5),
+	     BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 62, 0, 4),
+	     BPF_STMT(BPF_LDX | BPF_IMM, 2),
+	     BPF_JUMP(BPF_JMP | BPF_JSET | BPF_X, 0, 0, 2),
+	     BPF_JUMP(BPF_JMP | BPF_JGT | BPF_X, 0, 0, 1),
+	     BPF_STMT(BPF_RET | BPF_K, 2),
+	     BPF_STMT(BPF_RET | BPF_K, 3)),
+};
+
+/* Ethernet, IPv4 and TCP headers followed by 8 bytes of payload */
+static const u8 packet[] __initconst = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x00, 0x66,
+	0x77, 0x88, 0x99, 0xaa, 0x08, 0x00,
+	0x45, 0x00, 0x00, 0x30, 0x12, 0x34, 0x40, 0x00,
+	0x40, 0x06, 0x00, 0x00, 0xc0, 0xa8, 0x00, 0x01,
+	0xc0, 0xa8, 0x00, 0x02,
+	0x9c, 0x40, 0x00, 0x50, 0x00, 0x00, 0x00, 0x01,
+	0x00, 0x00, 0x00, 0x00, 0x50, 0x02, 0x20, 0x00,
+	0x00, 0x00, 0x00, 0x00,
+	0xde, 0xad, 0xbe, 0xef, 0xca, 0xfe, 0xba, 0xbe,
+};
+
+/*
+ * Build a packet with @linear bytes in the head and the rest of the
+ * first @len bytes in a page fragment.
+ */
+static struct sk_buff * __init make_skb(unsigned len, unsigned linear)
+{
+	struct sk_buff *skb;
+	struct page *page;
+
+	skb = alloc_skb(linear, GFP_KERNEL);
+	if (skb == NULL)
+		return NULL;
+
+	memcpy(skb_put(skb, linear), packet, linear);
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+	skb->protocol = htons(ETH_P_IP);
+
+	if (len > linear) {
+		page = alloc_page(GFP_KERNEL);
+		if (page == NULL) {
+			kfree_skb(skb);
+			return NULL;
+		}
+		memcpy(page_address(page), packet + linear, len - linear);
+		skb_fill_page_desc(skb, 0, page, 0, len - linear);
+		skb->len += len - linear;
+		skb->data_len += len - linear;
+		skb->truesize += len - linear;
+	}
+
+	return skb;
+}
+
+static int __init run_test(const struct bpf_test *t, struct sk_buff **skbs,
+			   int nr_skbs)
+{
+	struct sk_filter *fp;
+	unsigned int want, got;
+	int i, err = 0;
+
+	fp = kzalloc(sizeof(*fp) + t->len * sizeof(struct sock_filter),
+		     GFP_KERNEL);
+	if (fp == NULL)
+		return -ENOMEM;
+
+	memcpy(fp->insns, t->insns, t->len * sizeof(struct sock_filter));
+	atomic_set(&fp->refcnt, 1);
+	fp->len = t->len;
+	fp->bpf_func = sk_run_filter;
+
+	err = sk_chk_filter(fp->insns, fp->len);
+	if (err) {
+		pr_err("%s: rejected by sk_chk_filter(): %d\n", t->name, err);
+		goto out;
+	}
+
+	bpf_jit_compile(fp);
+	if (fp->bpf_func == sk_run_filter) {
+		pr_info("%s: not compiled, skipped\n", t->name);
+		goto out;
+	}
+
+	for (i = 0; i < nr_skbs; i++) {
+		want = sk_run_filter(skbs[i], fp->insns, fp->len);
+		got = SK_RUN_FILTER(fp, skbs[i]);
+		if (got != want) {
+			pr_err("%s: packet %d: JIT returned %u, interpreter %u\n",
+			       t->name, i, got, want);
+			err = -EINVAL;
+		}
+	}
+
+	bpf_jit_free(fp);
+out:
+	kfree(fp);
+	return err;
+}
+
+static int __init test_bpf_jit(void)
+{
+	struct sk_buff *skbs[3];
+	int saved_enable = bpf_jit_enable;
+	int i, err, failed = 0;
+
+	skbs[0] = make_skb(sizeof(packet), sizeof(packet));
+	skbs[1] = make_skb(sizeof(packet), 20);
+	skbs[2] = make_skb(20, 20);
+	for (i = 0; i < ARRAY_SIZE(skbs); i++)
+		if (skbs[i] == NULL) {
+			pr_err("out of memory\n");
+			goto out;
+		}
+
+	bpf_jit_enable = 1;
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		err = run_test(&tests[i], skbs, ARRAY_SIZE(skbs));
+		if (err)
+			failed++;
+	}
+	bpf_jit_enable = saved_enable;
+
+	if (failed)
+		pr_err("%d of %zu filters failed\n", failed, ARRAY_SIZE(tests));
+	else
+		pr_info("all %zu filters passed\n", ARRAY_SIZE(tests));
+out:
+	for (i = 0; i < ARRAY_SIZE(skbs); i++)
+		kfree_skb(skbs[i]);
+	return 0;
+}
+
+late_initcall(test_bpf_jit);
@@ -0,0 +1,280 @@
+/*
+ * omap-pcm-test.c  --  ALSA latency stress test for the OMAP PCM
+ *
+ * Plays silence through a PCM playback device with short periods from a
+ * SCHED_FIFO kernel thread, the way a low latency (VoIP) client does,
+ * and reports xruns, the longest gap between two period wakeups and the
+ * lowest fill level the ring ever dropped to.  Run it with whatever load
+ * should be survived (display, camera, network) going on:
+ *
+ *   modprobe snd-soc-omap-pcm-test pcm=/dev/snd/pcmC0D0p period_us=2500
+ *
+ * The results go to the kernel log and the module never stays loaded.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
+#include <sound/core.h>
+#include <sound/pcm.h>
+#include <sound/pcm_params.h>
+
+static char *pcm = "/dev/snd/pcmC0D0p";
+module_param(pcm, charp, 0);
+MODULE_PARM_DESC(pcm, "PCM playback device node to stress");
+
+static unsigned int rate = 48000;
+module_param(rate, uint, 0);
+MODULE_PARM_DESC(rate, "Sample rate in Hz");
+
+static unsigned int period_us = 2500;
+module_param(period_us, uint, 0);
+MODULE_PARM_DESC(period_us, "Period length in usecs");
+
+static unsigned int periods = 2;
+module_param(periods, uint, 0);
+MODULE_PARM_DESC(periods, "Periods in the ring");
+
+static unsigned int seconds = 10;
+module_param(seconds, uint, 0);
+MODULE_PARM_DESC(seconds, "Test duration in seconds");
+
+struct omap_pcm_test {
+	struct snd_pcm_substream	*substream;
+	snd_pcm_uframes_t		period_size;
+	struct completion		done;
+	int				ret;
+
+	unsigned long			written;
+	unsigned long			xruns;
+	s64				max_gap_us;
+	snd_pcm_sframes_t		min_fill;
+};
+
+static inline mm_segment_t snd_enter_user(void)
+{
+	mm_segment_t fs = get_fs();
+	set_fs(get_ds());
+	return fs;
+}
+
+static inline void snd_leave_user(mm_segment_t fs)
+{
+	set_fs(fs);
+}
+
+static void omap_pcm_test_mask(struct snd_pcm_hw_params *params,
+			       snd_pcm_hw_param_t var, unsigned int val)
+{
+	snd_mask_leave(hw_param_mask(params, var), val);
+}
+
+static void omap_pcm_test_interval(struct snd_pcm_hw_params *params,
+				   snd_pcm_hw_param_t var, unsigned int val)
+{
+	struct snd_interval *i = hw_param_interval(params, var);
+
+	i->min = i->max = val;
+	i->openmin = i->openmax = 0;
+	i->integer = 1;
+}
+
+static int omap_pcm_test_setup(struct omap_pcm_test *t)
+{
+	struct snd_pcm_substream *substream = t->substream;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_pcm_hw_params *params;
+	struct snd_pcm_sw_params *swparams;
+	int err;
+
+	params = kmalloc(sizeof(*params), GFP_KERNEL);
+	swparams = kzalloc(sizeof(*swparams), GFP_KERNEL);
+	if (params == NULL || swparams == NULL) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	t->period_size = div_u64((u64)rate * period_us, USEC_PER_SEC);
+
+	_snd_pcm_hw_params_any(params);
+	omap_pcm_test_mask(params, SNDRV_PCM_HW_PARAM_ACCESS,
+			   SNDRV_PCM_ACCESS_RW_INTERLEAVED);
+	omap_pcm_test_mask(params, SNDRV_PCM_HW_PARAM_FORMAT,
+			   SNDRV_PCM_FORMAT_S16_LE);
+	omap_pcm_test_interval(params, SNDRV_PCM_HW_PARAM_CHANNELS, 2);
+	omap_pcm_test_interval(params, SNDRV_PCM_HW_PARAM_RATE, rate);
+	omap_pcm_test_interval(params, SNDRV_PCM_HW_PARAM_PERIOD_SIZE,
+			       t->period_size);
+	omap_pcm_test_interval(params, SNDRV_PCM_HW_PARAM_PERIODS, periods);
+
+	err = snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_HW_PARAMS,
+				   params);
+	if (err < 0) {
+		pr_err("omap-pcm-test: %u Hz, %lu frame periods x %u "
+		       "not supported: %d\n", rate, t->period_size, periods,
+		       err);
+		goto out;
+	}
+
+	/* start on a full ring, wake up for every period */
+	swparams->tstamp_mode = SNDRV_PCM_TSTAMP_NONE;
+	swparams->period_step = 1;
+	swparams->avail_min = t->period_size;
+	swparams->start_threshold = runtime->buffer_size;
+	swparams->stop_threshold = runtime->buffer_size;
+	swparams->boundary = runtime->boundary;
+	err = snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_SW_PARAMS,
+				   swparams);
+	if (err < 0)
+		goto out;
+
+	err = snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_PREPARE, NULL);
+out:
+	kfree(swparams);
+	kfree(params);
+	return err;
+}
+
+static int omap_pcm_test_thread(void *data)
+{
+	struct omap_pcm_test *t = data;
+	struct snd_pcm_substream *substream = t->substream;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO / 2 };
+	ktime_t end, last, now;
+	snd_pcm_sframes_t fill, ret;
+	mm_segment_t fs;
+	void *buf;
+	s64 gap;
+
+	sched_setscheduler(current, SCHED_FIFO, &param);
+
+	buf = kzalloc(frames_to_bytes(runtime, t->period_size), GFP_KERNEL);
+	if (buf == NULL) {
+		t->ret = -ENOMEM;
+		goto out;
+	}
+
+	t->min_fill = runtime->buffer_size;
+	last = ktime_get();
+	end = ktime_add_ns(last, (u64)seconds * NSEC_PER_SEC);
+	do {
+		fs = snd_enter_user();
+		ret = snd_pcm_lib_write(substream, (void __user *)buf,
+					t->period_size);
+		snd_leave_user(fs);
+		now = ktime_get();
+
+		if (ret == -EPIPE) {
+			t->xruns++;
+			ret = snd_pcm_kernel_ioctl(substream,
+					SNDRV_PCM_IOCTL_PREPARE, NULL);
+			if (ret < 0)
+				break;
+			last = now;
+			continue;
+		}
+		if (ret < 0)
+			break;
+
+		/* the first buffer_size frames only fill the ring */
+		t->written += ret;
+		if (t->written <= runtime->buffer_size) {
+			last = now;
+			continue;
+		}
+
+		gap = ktime_us_delta(now, last);
+		if (gap > t->max_gap_us)
+			t->max_gap_us = gap;
+		last = now;
+
+		/* how much was still queued when we got to refill it */
+		snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_HWSYNC, NULL);
+		fill = snd_pcm_playback_hw_avail(runtime) - ret;
+		if (fill >= 0 && fill < t->min_fill)
+			t->min_fill = fill;
+	} while (ktime_us_delta(end, now) > 0);
+
+	t->ret = ret < 0 ? ret : 0;
+	snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_DROP, NULL);
+	kfree(buf);
+out:
+	complete(&t->done);
+	return 0;
+}
+
+static int __init omap_pcm_test_init(void)
+{
+	struct omap_pcm_test t;
+	struct snd_pcm_file *pcm_file;
+	struct task_struct *task;
+	struct file *file;
+	int err;
+
+	file = filp_open(pcm, O_WRONLY, 0);
+	if (IS_ERR(file)) {
+		pr_err("omap-pcm-test: can't open %s: %ld\n", pcm,
+		       PTR_ERR(file));
+		return PTR_ERR(file);
+	}
+
+	if (imajor(file->f_path.dentry->d_inode) != CONFIG_SND_MAJOR ||
+	    !snd_lookup_minor_data(iminor(file->f_path.dentry->d_inode),
+				   SNDRV_DEVICE_TYPE_PCM_PLAYBACK)) {
+		pr_err("omap-pcm-test: %s is not a PCM playback device\n", pcm);
+		err = -ENODEV;
+		goto out;
+	}
+
+	memset(&t, 0, sizeof(t));
+	pcm_file = file->private_data;
+	t.substream = pcm_file->substream;
+	init_completion(&t.done);
+
+	err = omap_pcm_test_setup(&t);
+	if (err < 0)
+		goto out;
+
+	task = kthread_run(omap_pcm_test_thread, &t, "omap-pcm-test");
+	if (IS_ERR(task)) {
+		err = PTR_ERR(task);
+		goto out;
+	}
+	wait_for_completion(&t.done);
+
+	if (t.ret < 0) {
+		pr_err("omap-pcm-test: write failed: %d\n", t.ret);
+		err = t.ret;
+		goto out;
+	}
+
+	pr_info("omap-pcm-test: %s: %u Hz, %lu frames x %u periods, %u s\n",
+		pcm, rate, t.period_size, periods, seconds);
+	pr_info("omap-pcm-test: %lu xruns, longest period gap %lld us "
+		"(period %u us), lowest fill %lu us\n", t.xruns,
+		t.max_gap_us, period_us,
+		(unsigned long)div_u64((u64)t.min_fill * USEC_PER_SEC, rate));
+	if (t.xruns)
+		pr_err("omap-pcm-test: FAILED\n");
+
+	/* nothing to keep around, so fail the load like tcrypt does */
+	err = -EAGAIN;
+out:
+	filp_close(file, NULL);
+	return err;
+}
+module_init(omap_pcm_test_init);
+
+MODULE_DESCRIPTION("ALSA latency stress test for the OMAP PCM");
+MODULE_LICENSE("GPL");
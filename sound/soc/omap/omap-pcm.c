@@ -52,6 +52,7 @@ struct omap_runtime_data {
 	struct omap_pcm_dma_data	*dma_data;
 	int				dma_ch;
 	int				period_index;
+	snd_pcm_uframes_t		last_offset;
 };
 
 static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
@@ -190,6 +191,14 @@ static int omap_pcm_prepare(struct snd_pcm_substream *substream)
 	bytes = snd_pcm_lib_period_bytes(substream);
 	dma_params.elem_count	= bytes >> dma_data->data_type;
 	dma_params.frame_count	= runtime->periods;
+	/*
+	 * The McBSP FIFO gives only a few ms of slack with short periods;
+	 * don't let display or camera traffic starve the audio channel.
+	 */
+	if (!cpu_class_is_omap1()) {
+		dma_params.read_prio	= DMA_CH_PRIO_HIGH;
+		dma_params.write_prio	= DMA_CH_PRIO_HIGH;
+	}
 	omap_set_dma_params(prtd->dma_ch, &dma_params);
 
 	if ((cpu_is_omap1510()))
@@ -222,6 +231,7 @@ static int omap_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
 		prtd->period_index = 0;
+		prtd->last_offset = 0;
 		/* Configure McBSP internal buffer usage */
 		if (dma_data->set_threshold)
 			dma_data->set_threshold(substream);
@@ -252,17 +262,29 @@ static snd_pcm_uframes_t omap_pcm_pointer(struct snd_pcm_substream *substream)
 
 	if (cpu_is_omap1510()) {
 		offset = prtd->period_index * runtime->period_size;
-	} else if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
-		ptr = omap_get_dma_dst_pos(prtd->dma_ch);
-		offset = bytes_to_frames(runtime, ptr - runtime->dma_addr);
 	} else {
-		ptr = omap_get_dma_src_pos(prtd->dma_ch);
+		if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+			ptr = omap_get_dma_dst_pos(prtd->dma_ch);
+		else
+			ptr = omap_get_dma_src_pos(prtd->dma_ch);
+
+		/*
+		 * With periods of a few ms, reporting 0 for a position read
+		 * outside the buffer (e.g. while the channel reloads at the
+		 * end of the ring) looks like a jump of a whole buffer to
+		 * ALSA.  Stay at the last good position instead.
+		 */
+		if (ptr < runtime->dma_addr ||
+		    ptr >= runtime->dma_addr + runtime->dma_bytes)
+			return prtd->last_offset;
+
 		offset = bytes_to_frames(runtime, ptr - runtime->dma_addr);
 	}
 
 	if (offset >= runtime->buffer_size)
 		offset = 0;
 
+	prtd->last_offset = offset;
 	return offset;
 }
 